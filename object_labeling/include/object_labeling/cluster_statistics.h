@@ -0,0 +1,65 @@
+#ifndef OBJECT_LABELING_CLUSTER_STATISTICS_H
+#define OBJECT_LABELING_CLUSTER_STATISTICS_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PointIndices.h>
+
+#include <Eigen/Core>
+
+#include <vector>
+
+/**
+ * @brief ClusterStatistics, size, centroid and axis aligned extent of one
+ * cluster. Computed from the index list of the cluster, the points are
+ * never copied into a cloud of their own.
+ */
+struct ClusterStatistics
+{
+  // pcl pointcloud types
+  typedef pcl::PointXYZRGB PointT;                // The Point Type
+  typedef pcl::PointCloud<PointT> PointCloud;     // The PointCloud Type
+
+  size_t num_points;                  //!< number of points
+  Eigen::Vector3d centroid;           //!< mean of the points
+  Eigen::Vector3f min;                //!< lower corner of the bounding box
+  Eigen::Vector3f max;                //!< upper corner of the bounding box
+
+  ClusterStatistics();
+
+  /**
+   * @brief add a point to the running sums, centroid holds the sum of the
+   * coordinates until finish() is called
+   *
+   * @param pt point of the cluster
+   */
+  void add(const PointT& pt)
+  {
+    ++num_points;
+    centroid += pt.getVector3fMap().cast<double>();
+    min = min.cwiseMin(pt.getVector3fMap());
+    max = max.cwiseMax(pt.getVector3fMap());
+  }
+
+  /**
+   * @brief turn the coordinate sum into the centroid
+   *
+   */
+  void finish()
+  {
+    if(num_points > 0)
+      centroid /= static_cast<double>(num_points);
+  }
+
+  /**
+   * @brief statistics of all clusters, directly from their index lists
+   *
+   * @param input clustered cloud
+   * @param clusters indices of the points of each cluster
+   * @param statistics statistics of each cluster
+   */
+  static void compute(const PointCloud& input, const std::vector<pcl::PointIndices>& clusters,
+                      std::vector<ClusterStatistics>& statistics);
+};
+
+#endif
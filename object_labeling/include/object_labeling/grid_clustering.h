@@ -0,0 +1,166 @@
+#ifndef OBJECT_LABELING_GRID_CLUSTERING_H
+#define OBJECT_LABELING_GRID_CLUSTERING_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PointIndices.h>
+
+#include <object_labeling/cluster_statistics.h>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief GridClustering, euclidean clustering without a search tree. Gives
+ * the same clusters as pcl::EuclideanClusterExtraction: connected
+ * components of the graph that links all points closer than the tolerance,
+ * clusters outside the size limits are dropped, the largest cluster comes
+ * first and the indices of a cluster are sorted.
+ *
+ * The points are bucketed into a grid with the tolerance as cell size, so
+ * neighbours are either in the same or in one of the 26 adjacent cells.
+ * Each pair of adjacent cells is visited once and the points are merged
+ * with a union find. For voxelized clouds (a few points per cell) this is
+ * linear in the number of points.
+ *
+ * The cells are hashed into a flat open addressing table, all buffers keep
+ * their capacity between clouds.
+ */
+class GridClustering
+{
+public:
+  // pcl pointcloud types
+  typedef pcl::PointXYZRGB PointT;                // The Point Type
+  typedef pcl::PointCloud<PointT> PointCloud;     // The PointCloud Type
+
+public:
+  /**
+   * @brief Construct a new GridClustering object
+   *
+   * @param tolerance maximum distance of neighbouring points of a cluster
+   * @param min_cluster_size minimum number of points of a cluster
+   * @param max_cluster_size maximum number of points of a cluster
+   */
+  GridClustering(float tolerance = 0.02f, int min_cluster_size = 100, int max_cluster_size = 2500);
+
+  /**
+   * @brief Destroy the GridClustering object
+   *
+   */
+  ~GridClustering();
+
+  /**
+   * @brief set the maximum distance of neighbouring points of a cluster
+   *
+   * @param tolerance distance in meter
+   */
+  void setClusterTolerance(float tolerance);
+
+  /**
+   * @brief set the minimum number of points of a cluster
+   *
+   * @param size number of points
+   */
+  void setMinClusterSize(int size);
+
+  /**
+   * @brief set the maximum number of points of a cluster
+   *
+   * @param size number of points
+   */
+  void setMaxClusterSize(int size);
+
+  /**
+   * @brief cluster the input cloud, clusters keeps the capacity of its
+   * index lists if it is reused
+   *
+   * @param input pointcloud, non finite points are ignored
+   * @param clusters indices of the points of each cluster, largest first
+   */
+  void extract(const PointCloud& input, std::vector<pcl::PointIndices>& clusters);
+
+  /**
+   * @brief cluster the input cloud and sum up the statistics of each
+   * cluster while its indices are collected
+   *
+   * @param input pointcloud, non finite points are ignored
+   * @param clusters indices of the points of each cluster, largest first
+   * @param statistics statistics of each cluster, same order as clusters
+   */
+  void extract(const PointCloud& input, std::vector<pcl::PointIndices>& clusters,
+               std::vector<ClusterStatistics>& statistics);
+
+  size_t cells() const { return cells_.size(); }    //!< occupied cells of the last cloud
+
+private:
+  /**
+   * @brief occupied grid cell, its points are order_[start, start + count)
+   *
+   */
+  struct Cell
+  {
+    int i, j, k;                      //!< grid index
+    uint32_t start;                   //!< first point in order_
+    uint32_t count;                   //!< number of points
+  };
+
+  /**
+   * @brief pack the grid index into a hash key, 21 bits per axis
+   *
+   */
+  static uint64_t cellKey(int i, int j, int k);
+
+  /**
+   * @brief index of the cell in cells_, -1 if not occupied
+   *
+   */
+  int64_t find(int i, int j, int k) const;
+
+  /**
+   * @brief index of the cell in cells_, inserts an empty cell if new
+   *
+   */
+  uint32_t findOrInsert(int i, int j, int k);
+
+  /**
+   * @brief double the size of the hash table and reinsert all cells
+   *
+   */
+  void grow();
+
+  /**
+   * @brief root of the component of point p, halves the path
+   *
+   */
+  uint32_t root(uint32_t p);
+
+  /**
+   * @brief link the points a and b if they are within the tolerance
+   *
+   */
+  void link(const PointCloud& input, uint32_t a, uint32_t b);
+
+  /**
+   * @brief clustering of both extract() variants, statistics are skipped if null
+   *
+   */
+  void cluster(const PointCloud& input, std::vector<pcl::PointIndices>& clusters,
+               std::vector<ClusterStatistics>* statistics);
+
+private:
+  float tolerance_;                                   //!< cluster tolerance, also the cell size
+  float inv_tolerance_;                               //!< 1 / tolerance_
+  int min_cluster_size_;                              //!< smaller clusters are dropped
+  int max_cluster_size_;                              //!< larger clusters are dropped
+  std::vector<uint64_t> keys_;                        //!< open addressing table: cell key per slot
+  std::vector<uint32_t> slots_;                       //!< open addressing table: index in cells_ per slot
+  size_t table_mask_;                                 //!< table size - 1, the size is a power of two
+  std::vector<Cell> cells_;                           //!< occupied cells of the current cloud
+  std::vector<int64_t> point_cells_;                  //!< cell of each point, -1 for non finite points
+  std::vector<uint32_t> order_;                       //!< points sorted by cell
+  std::vector<uint32_t> parents_;                     //!< union find forest over the points
+  std::vector<int> cluster_ids_;                      //!< cluster of each root, -1 if dropped
+  std::vector<uint32_t> roots_;                       //!< roots of the kept clusters, largest first
+};
+
+#endif
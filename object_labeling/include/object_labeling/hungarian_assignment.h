@@ -0,0 +1,66 @@
+#ifndef OBJECT_LABELING_HUNGARIAN_ASSIGNMENT_H
+#define OBJECT_LABELING_HUNGARIAN_ASSIGNMENT_H
+
+#include <Eigen/Core>
+
+#include <limits>
+#include <vector>
+
+/**
+ * @brief HungarianAssignment, globally optimal one to one assignment of the
+ * rows of a cost matrix to its columns (Hungarian method with potentials,
+ * O(n^2 m) for n <= m). Rectangular matrices are supported, the larger
+ * side keeps unassigned entries.
+ *
+ * Pairs can be excluded with a maximum cost: costs above it are clipped,
+ * so leaving a row unassigned is never worse than a pair at or above the
+ * maximum, and such pairs are dropped from the result.
+ *
+ * All buffers keep their capacity between calls, a few dozen rows and
+ * columns are solved in microseconds.
+ */
+class HungarianAssignment
+{
+public:
+  /**
+   * @brief Construct a new HungarianAssignment object
+   *
+   */
+  HungarianAssignment();
+
+  /**
+   * @brief Destroy the HungarianAssignment object
+   *
+   */
+  ~HungarianAssignment();
+
+  /**
+   * @brief minimum cost assignment
+   *
+   * @param cost cost of assigning row i to column j
+   * @param assignment column of each row, -1 if unassigned
+   * @param max_cost pairs with a cost of at least max_cost are not assigned
+   * @return double total cost of the assigned pairs
+   */
+  double solve(const Eigen::MatrixXd& cost, std::vector<int>& assignment,
+               double max_cost = std::numeric_limits<double>::infinity());
+
+private:
+  /**
+   * @brief assignment of all n rows of a n x m matrix, n <= m
+   *
+   * @param cost clipped cost matrix
+   * @param column_rows row of each column (1 based, 0 if unassigned)
+   */
+  void solveRows(const Eigen::MatrixXd& cost, std::vector<int>& column_rows);
+
+private:
+  Eigen::MatrixXd clipped_;             //!< clipped (and transposed) cost matrix
+  std::vector<double> u_, v_;           //!< row and column potentials
+  std::vector<double> min_slack_;       //!< smallest reduced cost per column of the current row
+  std::vector<int> column_rows_;        //!< row of each column, 1 based
+  std::vector<int> way_;                //!< previous column on the augmenting path
+  std::vector<char> used_;              //!< column visited in the current row
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include <sensor_msgs/image_encodings.h>
 #include <geometry_msgs/Point.h>
 #include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
 #include <visualization_msgs/MarkerArray.h>
 
 /*********************************************************************
@@ -21,8 +22,7 @@
 #include <message_filters/synchronizer.h>
 #include <message_filters/sync_policies/exact_time.h>
 #include <message_filters/sync_policies/approximate_time.h>
-#include <tf/transform_listener.h>
-#include <tf/transform_listener.h>
+#include <tf2_ros/message_filter.h>
 #include <tf/transform_broadcaster.h>
 #include <tf_conversions/tf_eigen.h>
 #include <sensor_msgs/Image.h>
@@ -52,6 +52,17 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+#include <perception_common/latest_frame_slot.h>
+#include <perception_common/stamped_history.h>
+#include <perception_common/transform_cache.h>
+#include <perception_common/latency_monitor.h>
+#include <object_labeling/grid_clustering.h>
+#include <object_labeling/object_tracker.h>
+#include <object_labeling/LabeledObjects.h>
+#include <object_labeling/hungarian_assignment.h>
+
+#include <diagnostic_msgs/DiagnosticArray.h>
+
 class ObjectLabeling
 {
 public:
@@ -59,12 +70,52 @@ public:
   typedef pcl::PointXYZRGB PointT;
   typedef pcl::PointCloud<PointT> PointCloud;
   typedef PointCloud::Ptr CloudPtr;
+  typedef PointCloud::ConstPtr CloudConstPtr;
 
   // plc labled pointcloud types (color RGB + object labels L)
   typedef pcl::PointXYZL PointTl;
   typedef pcl::PointCloud<PointTl> PointCloudl;
   typedef PointCloudl::Ptr CloudPtrl;
 
+  /**
+   * @brief available clustering methods
+   * 
+   */
+  enum ClusteringMethod
+  {
+    GRID,             //!< GridClustering, connected components on a hash grid
+    KDTREE            //!< pcl::EuclideanClusterExtraction with a kd tree built per cloud
+  };
+
+  /**
+   * @brief how the image rectangle of a cluster is obtained for the matching
+   * 
+   */
+  enum MatchProjection
+  {
+    BOUNDING_BOX,     //!< projected corners of the 3d bounding box
+    CLUSTER_POINTS    //!< projected (subsampled) points of the cluster
+  };
+
+  /**
+   * @brief timed processing stages
+   * 
+   */
+  enum Stage
+  {
+    STAGE_CLUSTERING,         //!< euclidean clustering
+    STAGE_CENTROIDS,          //!< cluster statistics (kd tree clustering only) and centroid publishing
+    STAGE_TF_LOOKUP,          //!< camera pose lookup
+    STAGE_MATCHING,           //!< projection and matching with the detections
+    STAGE_RELABEL,            //!< labeled cloud and text markers
+    STAGE_PUBLISH,            //!< conversion and publishing
+    STAGE_UPDATE,             //!< whole update
+    STAGE_STAMP_TO_PUBLISH,   //!< sensor stamp to publishing of the labeled cloud
+    STAGE_DETECTION_OFFSET,   //!< stamp difference of the cloud and the matched detections
+    STAGE_TRACKING,           //!< cluster to track assignment and label voting
+    STAGE_DETECTION_WAIT      //!< time a cloud waited for the detections of its image
+  };
+
 public:
   /**
    * @brief Construct a new Object Labeling object
@@ -86,33 +137,111 @@ public:
    * @brief Initialize the ObjectLabeling
    * 
    * @param nh ros node to create ros connections
+   * @param transform_cache tf access shared with other nodes of the process,
+   * a new one is created if empty
    * @return true succeess
    * @return false failure
    */
-  bool initalize(ros::NodeHandle& nh);
+  bool initalize(ros::NodeHandle& nh, std::shared_ptr<TransformCache> transform_cache = nullptr);
 
   /**
-   * @brief update ObjectLabeling, called periodically
+   * @brief block until a new objects pointcloud arrived (or timeout), the ros
+   * callbacks have to be served by another thread (e.g. ros::AsyncSpinner).
+   * While a cloud waits for its detections, until new detections arrived.
+   * 
+   * @param timeout maximum waiting time
+   * @return true new pointcloud available or a cloud waiting for detections
+   * @return false timeout
+   */
+  bool waitForCloud(const ros::Duration& timeout);
+
+  /**
+   * @brief update ObjectLabeling, processes the latest pointcloud once the
+   * detections of its image arrived or it waited for detection_wait
    * 
    * @param time 
    */
   void update(const ros::Time& time);
 
 private:
-  bool labelObjects(CloudPtr& input, CloudPtrl& output);
+  /**
+   * @brief cluster the objects cloud, match the clusters with the detections
+   * and track them. The points of each cluster are labeled with the id of
+   * its track, the text markers show the voted class.
+   * 
+   * @param input objects pointcloud
+   * @param output labeled pointcloud
+   * @return true success
+   * @return false camera pose not available
+   */
+  bool labelObjects(const CloudConstPtr& input, CloudPtrl& output);
 
-  int findMatch(const darknet_ros_msgs::BoundingBox& rect, const Eigen::MatrixXd& centroids);
+  /**
+   * @brief image rectangle of each cluster for the IoU of the matching,
+   * either from the corners of its 3d bounding box or from its points. The
+   * points of all clusters are subsampled into one matrix and projected
+   * with a single matrix product.
+   * 
+   * @param input clustered cloud
+   * @param T_camera_base transformation from cloud frame into camera frame
+   * @param cluster_rects image rectangle of each cluster, empty if not visible
+   */
+  void projectClusters(const PointCloud& input, const Eigen::Affine3d& T_camera_base,
+                       std::vector<cv::Rect2d>& cluster_rects);
+
+  /**
+   * @brief globally optimal assignment of the detections to the clusters.
+   * The cost of a pair mixes the IoU of the detection box with the image
+   * rectangle of the cluster and the pixel distance of their centers,
+   * pairs without overlap that are further apart than match_max_distance
+   * are never assigned.
+   * 
+   * @param pixel_centroids projected centroid of each cluster
+   * @param cluster_rects image rectangle of each cluster, empty if not visible
+   * @param labels label of each cluster, -1 if unmatched
+   * @param classes class name of each cluster, "unknown" if unmatched
+   */
+  void assignDetections(const std::vector<Eigen::Vector2d>& pixel_centroids,
+                        const std::vector<cv::Rect2d>& cluster_rects,
+                        std::vector<int>& labels, std::vector<std::string>& classes);
+
+  /**
+   * @brief fill labeled_objects_ with the points of all clusters, sorted by
+   * object with the offset table of the object ids. Written straight into
+   * the message buffer, with the color of the input if enabled.
+   * 
+   * @param input clustered cloud
+   */
+  void fillLabeledObjects(const PointCloud& input);
+
+  /**
+   * @brief publish the stage latencies on /diagnostics, at most once per second
+   * 
+   * @param time current time
+   */
+  void publishDiagnostics(const ros::Time& time);
 
 private:
   /**
-   * @brief objects pointcloud callback
+   * @brief objects pointcloud callback, called once the camera pose at the
+   * stamp of the cloud is known. The cloud is shared with the publisher
+   * within a nodelet manager, otherwise deserialized straight into pcl.
    * 
    * @param msg 
    */
-  void cloudCallback(const sensor_msgs::PointCloud2ConstPtr &msg);
+  void cloudCallback(const CloudConstPtr &msg);
 
   /**
-   * @brief detected bounding boxes from camera image
+   * @brief callback of the tf filter for clouds without camera pose
+   * 
+   * @param msg 
+   * @param reason 
+   */
+  void cloudDroppedCallback(const CloudConstPtr &msg, tf2_ros::FilterFailureReason reason);
+
+  /**
+   * @brief detected bounding boxes from camera image, kept in the history
+   * with the stamp of the image
    * 
    * @param msg 
    */
@@ -125,9 +254,15 @@ private:
    */
   void cameraInfoCallback(const sensor_msgs::CameraInfoConstPtr &msg);
 
+  /**
+   * @brief copy the camera matrix of the camera info
+   * 
+   * @param msg 
+   */
+  void setCameraInfo(const sensor_msgs::CameraInfo &msg);
+
 private:
 
-  bool is_cloud_updated_;                   //!< new pointcloud is recived
   bool has_camera_info_;                    //!< camera info recived
   std::string camera_frame_;                //!< camera frame name
   std::string objects_cloud_topic_;         //!< objects cloud topic name
@@ -135,25 +270,74 @@ private:
 
   Eigen::Matrix3d K_;                       //!< Camera matrix http://ksimek.github.io/2013/08/13/intrinsic/
 
+  std::shared_ptr<TransformCache> transform_cache_;  //!< access to tf tree, outlives the tf filter
   ros::Subscriber object_detections_sub_;   //!< sub detections form detector
-  ros::Subscriber object_point_cloud_sub_;  //!< sub point cloud from plane segmentation
+  message_filters::Subscriber<PointCloud> object_point_cloud_sub_;     //!< sub point cloud from plane segmentation
+  std::unique_ptr<tf2_ros::MessageFilter<PointCloud> > tf_filter_;      //!< holds clouds back until the camera pose is available
   ros::Subscriber camera_info_sub_;         //!< sub camera info
 
   ros::Publisher labeled_object_cloud_pub_; //!< publisher for labeled pointcloud
+  ros::Publisher labeled_objects_pub_;      //!< publisher for the labeled objects with per object offsets
   ros::Publisher text_marker_pub_;
   ros::Publisher centroid_pub_;
+  ros::Publisher diagnostics_pub_;          //!< publisher for the stage latencies
+  ros::Time last_diagnostics_time_;         //!< time of the last diagnostics message
 
   // outputs
   CloudPtrl labeled_point_cloud_;                 //!< labeled pointcloud (pointcloud that knows the object type)
   visualization_msgs::MarkerArray text_markers_;  //!< text markers for rviz
+  object_labeling::LabeledObjects labeled_objects_; //!< points sorted by object, keeps its capacity
+  bool labeled_objects_color_;                    //!< rgb field in labeled_objects_
+
+  // latest messages, handed over from the callback thread
+  LatestFrameSlot<CloudConstPtr> cloud_slot_;
+  LatestFrameSlot<sensor_msgs::CameraInfoConstPtr> camera_info_slot_;
 
   // inputs 
-  CloudPtr object_point_cloud_;                             //!< objects point cloud
-  std::vector<darknet_ros_msgs::BoundingBox> detections_;   //!< vector of bounding boxes in 2d image
+  CloudConstPtr object_point_cloud_;                        //!< objects point cloud, shared with the publisher
+  std::vector<darknet_ros_msgs::BoundingBox> detections_;   //!< vector of bounding boxes in 2d image, closest to the cloud
+  ros::Time detections_stamp_;                              //!< image stamp of detections_
+
+  // detections of the last images, matched to the clouds by stamp
+  StampedHistory<darknet_ros_msgs::BoundingBoxesConstPtr> detection_history_;
+  double max_detection_offset_;             //!< maximum stamp difference of cloud and detections in seconds
+  double detection_wait_;                   //!< maximum time a cloud waits for the detections of its image in seconds
+  LatestFrameSlot<ros::Time> detection_slot_;   //!< image stamp of the newest detections, wakes a waiting cloud
+  ros::Time newest_detection_stamp_;        //!< image stamp of the newest detections taken from detection_slot_
+  CloudConstPtr pending_cloud_;             //!< cloud waiting for the detections of its image
+  ros::Time pending_since_;                 //!< time the pending cloud was taken from cloud_slot_
+
+  std::map<std::string, int> dict_;         //!< mapping of object names to class label
+  std::vector<std::string> class_names_;    //!< object name of each class label
+
+  // clustering
+  ClusteringMethod clustering_method_;      //!< clustering method
+  float cluster_tolerance_;                 //!< maximum distance of neighbouring points of an object
+  int min_cluster_size_;                    //!< minimum number of points of an object
+  int max_cluster_size_;                    //!< maximum number of points of an object
+  GridClustering grid_clustering_;          //!< tree free euclidean clustering
+  std::vector<pcl::PointIndices> cluster_indices_;        //!< point indices of each cluster, largest first
+  std::vector<ClusterStatistics> cluster_statistics_;     //!< size, centroid and extent of each cluster
+
+  // matching
+  MatchProjection match_projection_;        //!< image rectangles of the clusters
+  int projection_max_points_;               //!< points per cluster projected with CLUSTER_POINTS
+  Eigen::Matrix3Xf projection_points_;      //!< subsampled points of all clusters, cloud frame
+  Eigen::Matrix3Xf projected_points_;       //!< the same points in homogenous pixel coordinates
+  std::vector<size_t> projection_offsets_;  //!< first column of each cluster, one past the end at the back
+  double match_max_distance_;               //!< pixel distance of box and cluster centers without overlap
+  double match_iou_weight_;                 //!< weight of the IoU in the matching cost, the distance gets the rest
+  HungarianAssignment assignment_;          //!< detection to cluster assignment
+  std::vector<size_t> known_detections_;    //!< detections with a class in dict_
+  Eigen::MatrixXd match_costs_;             //!< cost of each detection / cluster pair
+  std::vector<int> detection_clusters_;     //!< assigned cluster of each known detection
 
-  tf::TransformListener tfListener_;        //!< access to tf tree for ros transformations
+  // tracking
+  ObjectTracker tracker_;                   //!< stable ids and voted class labels of the clusters
+  std::vector<uint32_t> track_ids_;         //!< track id of each cluster, the label of its points
+  std::vector<int> track_labels_;           //!< voted class label of each cluster, -1 if unknown
 
-  std::map<std::string, int> dict_;         //!< mapping of object names to pointcloud label
+  LatencyMonitor latency_monitor_;          //!< per stage timing
 };
 
 #endif
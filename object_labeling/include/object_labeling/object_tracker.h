@@ -0,0 +1,117 @@
+#ifndef OBJECT_LABELING_OBJECT_TRACKER_H
+#define OBJECT_LABELING_OBJECT_TRACKER_H
+
+#include <ros/time.h>
+
+#include <object_labeling/cluster_statistics.h>
+#include <object_labeling/hungarian_assignment.h>
+
+#include <Eigen/Core>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief ObjectTracker, keeps the clusters of consecutive frames apart as
+ * tracks with a stable id and a class label voted over all frames.
+ *
+ * Each frame the predicted track positions are assigned to the cluster
+ * centroids (HungarianAssignment on the euclidean distance), pairs further
+ * apart than the gate are not assigned. Assigned tracks are corrected with
+ * an alpha beta filter, unassigned clusters start new tracks and tracks
+ * without a cluster for longer than the maximum age are removed.
+ *
+ * Every matched detection adds a vote for its class to the histogram of the
+ * track, the label of a track is the class with the most votes. A frame in
+ * which the detector misses the object adds no vote, so the label does not
+ * drop back to unknown.
+ */
+class ObjectTracker
+{
+public:
+  /**
+   * @brief motion model of the tracks
+   *
+   */
+  enum MotionModel
+  {
+    STATIC,               //!< objects do not move, the position is smoothed
+    CONSTANT_VELOCITY     //!< position and velocity, alpha beta filter
+  };
+
+public:
+  /**
+   * @brief Construct a new ObjectTracker object
+   *
+   * @param gate maximum distance of a cluster to the predicted track position in meter
+   * @param max_age time after which a track without clusters is removed in seconds
+   * @param model motion model of the tracks
+   */
+  ObjectTracker(double gate = 0.1, double max_age = 2.0, MotionModel model = STATIC);
+
+  /**
+   * @brief Destroy the ObjectTracker object
+   *
+   */
+  ~ObjectTracker();
+
+  void setGate(double gate) { gate_ = gate; }                   //!< maximum cluster distance in meter
+  void setMaxAge(double max_age) { max_age_ = max_age; }        //!< lifetime without clusters in seconds
+  void setMotionModel(MotionModel model) { model_ = model; }    //!< motion model of the tracks
+
+  /**
+   * @brief remove all tracks, ids keep counting up
+   *
+   */
+  void reset();
+
+  /**
+   * @brief track the clusters of a new frame
+   *
+   * @param stamp time of the frame, a time jump back resets the tracker
+   * @param statistics statistics of each cluster, centroid in the tracking frame
+   * @param labels class label of the detection matched to each cluster, -1 if none
+   * @param track_ids id of the track of each cluster
+   * @param track_labels voted class label of each cluster, -1 if it never got a vote
+   */
+  void update(const ros::Time& stamp, const std::vector<ClusterStatistics>& statistics,
+              const std::vector<int>& labels, std::vector<uint32_t>& track_ids,
+              std::vector<int>& track_labels);
+
+  size_t size() const { return tracks_.size(); }    //!< number of live tracks
+
+private:
+  /**
+   * @brief one tracked object
+   *
+   */
+  struct Track
+  {
+    uint32_t id;                        //!< stable id, never reused
+    Eigen::Vector3d position;           //!< filtered centroid
+    Eigen::Vector3d velocity;           //!< filtered velocity, zero for STATIC
+    ros::Time stamp;                    //!< time of the last assigned cluster
+    std::vector<uint32_t> votes;        //!< number of matched detections per class label
+    int label;                          //!< class with the most votes, -1 if none
+
+    void vote(int class_label);         //!< count a detection, update the label
+  };
+
+private:
+  double gate_;                         //!< maximum distance of cluster and predicted track
+  double max_age_;                      //!< lifetime of tracks without clusters
+  MotionModel model_;                   //!< motion model
+  double alpha_;                        //!< position gain of the filter
+  double beta_;                         //!< velocity gain of the filter
+  uint32_t next_id_;                    //!< id of the next new track
+  ros::Time last_stamp_;                //!< time of the last frame
+
+  std::vector<Track> tracks_;           //!< live tracks
+  std::vector<Eigen::Vector3d> predictions_;  //!< predicted position of each track
+  HungarianAssignment assignment_;      //!< track to cluster assignment
+  Eigen::MatrixXd costs_;               //!< distance of each track / cluster pair
+  std::vector<int> track_clusters_;     //!< assigned cluster of each track
+  std::vector<char> tracked_;           //!< cluster assigned to a track
+};
+
+#endif
@@ -0,0 +1,202 @@
+#include <object_labeling/grid_clustering.h>
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/segmentation/extract_clusters.h>
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * Offline benchmark of the object clustering. Clusters all pcd files of a
+ * directory with pcl::EuclideanClusterExtraction (kd tree built per cloud,
+ * like clustering_method kdtree) and with GridClustering (clustering_method
+ * grid), checks that both find the same clusters and reports the timings.
+ *
+ * The clouds are expected to be objects clouds of the table scene, e.g.
+ * /objects_point_cloud recorded with pcl_ros pointcloud_to_pcd.
+ */
+
+namespace {
+
+typedef pcl::PointXYZRGB PointT;
+typedef pcl::PointCloud<PointT> PointCloud;
+typedef std::chrono::steady_clock Clock;
+
+void printUsage()
+{
+  std::printf(
+    "usage: object_labeling_benchmark <pcd_directory> [options]\n"
+    "  --repeat N                      timed passes over the directory (default 10)\n"
+    "  --tolerance D                   cluster tolerance (default 0.02)\n"
+    "  --min-size N                    minimum cluster size (default 100)\n"
+    "  --max-size N                    maximum cluster size (default 2500)\n");
+}
+
+/**
+ * @brief load all pcd files of a directory, sorted by name
+ */
+bool loadClouds(const std::string& directory, std::vector<PointCloud::Ptr>& clouds)
+{
+  DIR* dir = opendir(directory.c_str());
+  if(!dir)
+  {
+    std::fprintf(stderr, "cannot open directory %s\n", directory.c_str());
+    return false;
+  }
+  std::vector<std::string> files;
+  while(dirent* entry = readdir(dir))
+  {
+    std::string name = entry->d_name;
+    if(name.size() > 4 && name.compare(name.size() - 4, 4, ".pcd") == 0)
+      files.push_back(directory + "/" + name);
+  }
+  closedir(dir);
+  std::sort(files.begin(), files.end());
+
+  for(const std::string& file : files)
+  {
+    PointCloud::Ptr cloud(new PointCloud);
+    if(pcl::io::loadPCDFile(file, *cloud) < 0)
+    {
+      std::fprintf(stderr, "cannot read %s\n", file.c_str());
+      return false;
+    }
+    clouds.push_back(cloud);
+  }
+  return !clouds.empty();
+}
+
+/**
+ * @brief clusters as sorted index lists in a canonical order
+ */
+std::vector<std::vector<int> > canonical(const std::vector<pcl::PointIndices>& clusters)
+{
+  std::vector<std::vector<int> > result;
+  for(const pcl::PointIndices& cluster : clusters)
+  {
+    result.push_back(cluster.indices);
+    std::sort(result.back().begin(), result.back().end());
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+/**
+ * @brief mean, median and maximum of the frame times in ms
+ */
+void printTimes(const char* name, std::vector<double>& times)
+{
+  std::sort(times.begin(), times.end());
+  double mean = 0.0;
+  for(double t : times)
+    mean += t;
+  mean /= times.size();
+  std::printf("%-20s mean %.3f ms, p50 %.3f ms, max %.3f ms\n",
+    name, 1e3 * mean, 1e3 * times[times.size() / 2], 1e3 * times.back());
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  if(argc < 2 || std::strcmp(argv[1], "--help") == 0)
+  {
+    printUsage();
+    return argc < 2 ? 1 : 0;
+  }
+
+  std::string directory = argv[1];
+  int repeat = 10;
+  float tolerance = 0.02f;
+  int min_size = 100;
+  int max_size = 2500;
+
+  for(int i = 2; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if(arg == "--repeat" && has_value)
+      repeat = std::atoi(argv[++i]);
+    else if(arg == "--tolerance" && has_value)
+      tolerance = std::atof(argv[++i]);
+    else if(arg == "--min-size" && has_value)
+      min_size = std::atoi(argv[++i]);
+    else if(arg == "--max-size" && has_value)
+      max_size = std::atoi(argv[++i]);
+    else
+    {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if(repeat < 1 || !(tolerance > 0.0f) || min_size < 1 || min_size > max_size)
+  {
+    printUsage();
+    return 1;
+  }
+
+  std::vector<PointCloud::Ptr> clouds;
+  if(!loadClouds(directory, clouds))
+  {
+    std::fprintf(stderr, "no pcd files in %s\n", directory.c_str());
+    return 1;
+  }
+
+  GridClustering grid_clustering(tolerance, min_size, max_size);
+  std::vector<pcl::PointIndices> kdtree_clusters, grid_clusters;
+  std::vector<double> kdtree_times, grid_times;
+  size_t points = 0, clusters = 0, mismatches = 0;
+
+  // the first pass grows the buffers of the grid clustering and is not timed
+  for(int pass = 0; pass <= repeat; ++pass)
+  {
+    for(const PointCloud::Ptr& cloud : clouds)
+    {
+      // the kd tree is rebuilt per cloud, as in ObjectLabeling
+      Clock::time_point start = Clock::now();
+      pcl::search::KdTree<PointT>::Ptr tree(new pcl::search::KdTree<PointT>);
+      tree->setInputCloud(cloud);
+      pcl::EuclideanClusterExtraction<PointT> ec;
+      ec.setClusterTolerance(tolerance);
+      ec.setMinClusterSize(min_size);
+      ec.setMaxClusterSize(max_size);
+      ec.setSearchMethod(tree);
+      ec.setInputCloud(cloud);
+      ec.extract(kdtree_clusters);
+      std::chrono::duration<double> kdtree_time = Clock::now() - start;
+
+      start = Clock::now();
+      grid_clustering.extract(*cloud, grid_clusters);
+      std::chrono::duration<double> grid_time = Clock::now() - start;
+
+      if(pass == 0)
+      {
+        // distances right at the tolerance may be decided differently
+        if(canonical(kdtree_clusters) != canonical(grid_clusters))
+          ++mismatches;
+        continue;
+      }
+      kdtree_times.push_back(kdtree_time.count());
+      grid_times.push_back(grid_time.count());
+      points += cloud->size();
+      clusters += grid_clusters.size();
+    }
+  }
+
+  size_t frames = grid_times.size();
+  std::printf("clouds:              %zu (%d passes), %.0f points and %.1f clusters per cloud\n",
+    clouds.size(), repeat, static_cast<double>(points) / frames, static_cast<double>(clusters) / frames);
+  std::printf("different clusters:  %zu of %zu clouds\n", mismatches, clouds.size());
+  printTimes("kdtree:", kdtree_times);
+  printTimes("grid:", grid_times);
+  return 0;
+}
@@ -21,15 +21,16 @@ int main(int argc, char** argv)
     return -1;
   }
 
-  // Run
-  ros::Rate rate(30);
+  // Run, callbacks are served in the background
+  ros::AsyncSpinner spinner(1);
   ros::Duration(2.0).sleep();
+  spinner.start();
   while(ros::ok())
   {
-    labeling.update(ros::Time(0));
-    ros::spinOnce();
-    rate.sleep();
+    if(labeling.waitForCloud(ros::Duration(0.1)))
+      labeling.update(ros::Time::now());
   }
+  spinner.stop();
 
   return 0;
 }
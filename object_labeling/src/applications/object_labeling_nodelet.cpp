@@ -0,0 +1,72 @@
+#include <object_labeling/object_labeling.h>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <atomic>
+#include <thread>
+
+/**
+ * @brief ObjectLabelingNodelet, runs ObjectLabeling inside a nodelet
+ * manager. The objects cloud of PlaneSegmentationNodelet in the same manager
+ * arrives as a shared pointer without serialization.
+ *
+ * Like object_labeling_node the processing runs in its own thread, the
+ * manager threads only serve the callbacks.
+ *
+ * Private parameters: objects_cloud_topic, camera_info_topic, camera_frame
+ */
+class ObjectLabelingNodelet : public nodelet::Nodelet
+{
+public:
+  ObjectLabelingNodelet() :
+    running_(false)
+  {
+  }
+
+  ~ObjectLabelingNodelet()
+  {
+    running_ = false;
+    if(worker_.joinable())
+      worker_.join();
+  }
+
+private:
+  void onInit() override
+  {
+    ros::NodeHandle& nh = getNodeHandle();
+    ros::NodeHandle& pnh = getPrivateNodeHandle();
+
+    std::string objects_cloud_topic, camera_info_topic, camera_frame;
+    pnh.param<std::string>("objects_cloud_topic", objects_cloud_topic, "/objects_point_cloud");
+    pnh.param<std::string>("camera_info_topic", camera_info_topic, "/hsrb/head_rgbd_sensor/depth_registered/camera_info");
+    pnh.param<std::string>("camera_frame", camera_frame, "head_rgbd_sensor_rgb_frame");
+
+    // one tf buffer for all nodelets of the manager
+    labeling_.reset(new ObjectLabeling(objects_cloud_topic, camera_info_topic, camera_frame));
+    if(!labeling_->initalize(nh, TransformCache::instance(nh)))
+    {
+      NODELET_ERROR_STREAM("Error init ObjectLabeling");
+      return;
+    }
+
+    running_ = true;
+    worker_ = std::thread(&ObjectLabelingNodelet::run, this);
+  }
+
+  void run()
+  {
+    while(running_ && ros::ok())
+    {
+      if(labeling_->waitForCloud(ros::Duration(0.1)))
+        labeling_->update(ros::Time::now());
+    }
+  }
+
+private:
+  std::unique_ptr<ObjectLabeling> labeling_;    //!< processing, created in onInit()
+  std::atomic<bool> running_;                   //!< worker keeps processing
+  std::thread worker_;                          //!< processing thread
+};
+
+PLUGINLIB_EXPORT_CLASS(ObjectLabelingNodelet, nodelet::Nodelet)
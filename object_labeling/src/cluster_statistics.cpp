@@ -0,0 +1,23 @@
+#include <object_labeling/cluster_statistics.h>
+
+#include <limits>
+
+ClusterStatistics::ClusterStatistics() :
+  num_points(0),
+  centroid(Eigen::Vector3d::Zero()),
+  min(Eigen::Vector3f::Constant(std::numeric_limits<float>::max())),
+  max(Eigen::Vector3f::Constant(-std::numeric_limits<float>::max()))
+{
+}
+
+void ClusterStatistics::compute(const PointCloud& input, const std::vector<pcl::PointIndices>& clusters,
+                                std::vector<ClusterStatistics>& statistics)
+{
+  statistics.assign(clusters.size(), ClusterStatistics());
+  for(size_t i = 0; i < clusters.size(); ++i)
+  {
+    for(int idx : clusters[i].indices)
+      statistics[i].add(input.points[idx]);
+    statistics[i].finish();
+  }
+}
@@ -0,0 +1,273 @@
+#include <object_labeling/grid_clustering.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const uint64_t kEmptyKey = std::numeric_limits<uint64_t>::max();   // never a valid 63 bit key
+const size_t kMinTableSize = 1 << 10;
+
+}  // namespace
+
+GridClustering::GridClustering(float tolerance, int min_cluster_size, int max_cluster_size) :
+  min_cluster_size_(min_cluster_size),
+  max_cluster_size_(max_cluster_size),
+  keys_(kMinTableSize, kEmptyKey),
+  slots_(kMinTableSize, 0),
+  table_mask_(kMinTableSize - 1)
+{
+  setClusterTolerance(tolerance);
+}
+
+GridClustering::~GridClustering()
+{
+}
+
+void GridClustering::setClusterTolerance(float tolerance)
+{
+  tolerance_ = tolerance;
+  inv_tolerance_ = 1.0f / tolerance;
+}
+
+void GridClustering::setMinClusterSize(int size)
+{
+  min_cluster_size_ = size;
+}
+
+void GridClustering::setMaxClusterSize(int size)
+{
+  max_cluster_size_ = size;
+}
+
+uint64_t GridClustering::cellKey(int i, int j, int k)
+{
+  // 21 bits per axis, enough for +-20km at 2cm tolerance
+  return (static_cast<uint64_t>(i & 0x1FFFFF) << 42) |
+         (static_cast<uint64_t>(j & 0x1FFFFF) << 21) |
+          static_cast<uint64_t>(k & 0x1FFFFF);
+}
+
+int64_t GridClustering::find(int i, int j, int k) const
+{
+  // fibonacci hashing, linear probing
+  uint64_t key = cellKey(i, j, k);
+  size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & table_mask_;
+  while(keys_[slot] != kEmptyKey)
+  {
+    if(keys_[slot] == key)
+      return slots_[slot];
+    slot = (slot + 1) & table_mask_;
+  }
+  return -1;
+}
+
+uint32_t GridClustering::findOrInsert(int i, int j, int k)
+{
+  // keep the load factor below 1/2
+  if(2 * (cells_.size() + 1) > keys_.size())
+    grow();
+
+  uint64_t key = cellKey(i, j, k);
+  size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & table_mask_;
+  while(keys_[slot] != kEmptyKey)
+  {
+    if(keys_[slot] == key)
+      return slots_[slot];
+    slot = (slot + 1) & table_mask_;
+  }
+
+  keys_[slot] = key;
+  slots_[slot] = static_cast<uint32_t>(cells_.size());
+  cells_.push_back(Cell{i, j, k, 0, 0});
+  return slots_[slot];
+}
+
+void GridClustering::grow()
+{
+  size_t size = 2 * keys_.size();
+  keys_.assign(size, kEmptyKey);
+  slots_.assign(size, 0);
+  table_mask_ = size - 1;
+
+  for(size_t idx = 0; idx < cells_.size(); ++idx)
+  {
+    uint64_t key = cellKey(cells_[idx].i, cells_[idx].j, cells_[idx].k);
+    size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & table_mask_;
+    while(keys_[slot] != kEmptyKey)
+      slot = (slot + 1) & table_mask_;
+    keys_[slot] = key;
+    slots_[slot] = static_cast<uint32_t>(idx);
+  }
+}
+
+uint32_t GridClustering::root(uint32_t p)
+{
+  while(parents_[p] != p)
+  {
+    parents_[p] = parents_[parents_[p]];
+    p = parents_[p];
+  }
+  return p;
+}
+
+void GridClustering::link(const PointCloud& input, uint32_t a, uint32_t b)
+{
+  uint32_t root_a = root(a);
+  uint32_t root_b = root(b);
+  if(root_a == root_b)
+    return;
+  if((input.points[a].getVector3fMap() - input.points[b].getVector3fMap()).squaredNorm() > tolerance_ * tolerance_)
+    return;
+
+  // the smaller index becomes the root, keeps the forest independent of the visiting order
+  if(root_a < root_b)
+    parents_[root_b] = root_a;
+  else
+    parents_[root_a] = root_b;
+}
+
+void GridClustering::extract(const PointCloud& input, std::vector<pcl::PointIndices>& clusters)
+{
+  cluster(input, clusters, nullptr);
+}
+
+void GridClustering::extract(const PointCloud& input, std::vector<pcl::PointIndices>& clusters,
+                             std::vector<ClusterStatistics>& statistics)
+{
+  cluster(input, clusters, &statistics);
+}
+
+void GridClustering::cluster(const PointCloud& input, std::vector<pcl::PointIndices>& clusters,
+                             std::vector<ClusterStatistics>* statistics)
+{
+  std::fill(keys_.begin(), keys_.end(), kEmptyKey);
+  cells_.clear();
+
+  // bucket the points into cells
+  const size_t num_points = input.points.size();
+  point_cells_.resize(num_points);
+  for(size_t p = 0; p < num_points; ++p)
+  {
+    const PointT& pt = input.points[p];
+    if(!std::isfinite(pt.x) || !std::isfinite(pt.y) || !std::isfinite(pt.z))
+    {
+      point_cells_[p] = -1;
+      continue;
+    }
+    uint32_t cell = findOrInsert(static_cast<int>(std::floor(pt.x * inv_tolerance_)),
+                                 static_cast<int>(std::floor(pt.y * inv_tolerance_)),
+                                 static_cast<int>(std::floor(pt.z * inv_tolerance_)));
+    ++cells_[cell].count;
+    point_cells_[p] = cell;
+  }
+
+  // counting sort of the points by cell
+  uint32_t start = 0;
+  for(Cell& cell : cells_)
+  {
+    cell.start = start;
+    start += cell.count;
+    cell.count = 0;
+  }
+  order_.resize(start);
+  for(size_t p = 0; p < num_points; ++p)
+  {
+    if(point_cells_[p] < 0)
+      continue;
+    Cell& cell = cells_[point_cells_[p]];
+    order_[cell.start + cell.count++] = static_cast<uint32_t>(p);
+  }
+
+  parents_.resize(num_points);
+  for(size_t p = 0; p < num_points; ++p)
+    parents_[p] = static_cast<uint32_t>(p);
+
+  // link the points within each cell and with the 13 forward neighbour
+  // cells, the other 13 neighbours visit this cell themselves
+  for(const Cell& cell : cells_)
+  {
+    const uint32_t* begin = order_.data() + cell.start;
+    const uint32_t* end = begin + cell.count;
+    for(const uint32_t* a = begin; a != end; ++a)
+      for(const uint32_t* b = a + 1; b != end; ++b)
+        link(input, *a, *b);
+
+    for(int dk = 0; dk <= 1; ++dk)
+    {
+      for(int dj = dk ? -1 : 0; dj <= 1; ++dj)
+      {
+        for(int di = (dk || dj) ? -1 : 1; di <= 1; ++di)
+        {
+          int64_t neighbour = find(cell.i + di, cell.j + dj, cell.k + dk);
+          if(neighbour < 0)
+            continue;
+          const uint32_t* other_begin = order_.data() + cells_[neighbour].start;
+          const uint32_t* other_end = other_begin + cells_[neighbour].count;
+          for(const uint32_t* a = begin; a != end; ++a)
+            for(const uint32_t* b = other_begin; b != other_end; ++b)
+              link(input, *a, *b);
+        }
+      }
+    }
+  }
+
+  // parents always have smaller indices, so one ascending pass points
+  // every point straight to its root. Component sizes are counted there.
+  cluster_ids_.assign(num_points, 0);
+  for(size_t p = 0; p < num_points; ++p)
+  {
+    parents_[p] = parents_[parents_[p]];
+    if(point_cells_[p] >= 0)
+      ++cluster_ids_[parents_[p]];
+  }
+
+  // clusters within the size limits, largest first (ties by root index)
+  roots_.clear();
+  for(size_t p = 0; p < num_points; ++p)
+  {
+    if(parents_[p] != p || point_cells_[p] < 0)
+      continue;
+    if(cluster_ids_[p] >= min_cluster_size_ && cluster_ids_[p] <= max_cluster_size_)
+      roots_.push_back(static_cast<uint32_t>(p));
+  }
+  std::stable_sort(roots_.begin(), roots_.end(), [this](uint32_t a, uint32_t b) {
+    return cluster_ids_[a] > cluster_ids_[b];
+  });
+
+  // the roots get the cluster id, dropped components -1
+  clusters.resize(roots_.size());
+  for(size_t p = 0; p < num_points; ++p)
+  {
+    if(parents_[p] == p)
+      cluster_ids_[p] = -1;
+  }
+  for(size_t id = 0; id < roots_.size(); ++id)
+  {
+    clusters[id].header = input.header;
+    clusters[id].indices.clear();
+    cluster_ids_[roots_[id]] = static_cast<int>(id);
+  }
+  if(statistics)
+    statistics->assign(roots_.size(), ClusterStatistics());
+
+  // ascending pass, the indices end up sorted and the statistics are
+  // summed up while the clusters are collected
+  for(size_t p = 0; p < num_points; ++p)
+  {
+    if(point_cells_[p] < 0)
+      continue;
+    int id = cluster_ids_[parents_[p]];
+    if(id < 0)
+      continue;
+    clusters[id].indices.push_back(static_cast<int>(p));
+    if(statistics)
+      (*statistics)[id].add(input.points[p]);
+  }
+  if(statistics)
+  {
+    for(ClusterStatistics& cluster_statistics : *statistics)
+      cluster_statistics.finish();
+  }
+}
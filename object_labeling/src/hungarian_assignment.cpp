@@ -0,0 +1,103 @@
+#include <object_labeling/hungarian_assignment.h>
+
+#include <algorithm>
+
+HungarianAssignment::HungarianAssignment()
+{
+}
+
+HungarianAssignment::~HungarianAssignment()
+{
+}
+
+double HungarianAssignment::solve(const Eigen::MatrixXd& cost, std::vector<int>& assignment, double max_cost)
+{
+  assignment.assign(cost.rows(), -1);
+  if(cost.rows() == 0 || cost.cols() == 0)
+    return 0.0;
+
+  // the solver assigns every row, so the smaller side becomes the rows
+  bool transposed = cost.rows() > cost.cols();
+  if(transposed)
+    clipped_ = cost.transpose().cwiseMin(max_cost);
+  else
+    clipped_ = cost.cwiseMin(max_cost);
+  solveRows(clipped_, column_rows_);
+
+  double total = 0.0;
+  for(int j = 0; j < clipped_.cols(); ++j)
+  {
+    int i = column_rows_[j + 1] - 1;
+    if(i < 0 || clipped_(i, j) >= max_cost)
+      continue;
+    total += clipped_(i, j);
+    if(transposed)
+      assignment[j] = i;
+    else
+      assignment[i] = j;
+  }
+  return total;
+}
+
+void HungarianAssignment::solveRows(const Eigen::MatrixXd& cost, std::vector<int>& column_rows)
+{
+  // shortest augmenting paths with row/column potentials, 1 based with
+  // column 0 as the virtual start of each path
+  const int n = cost.rows();
+  const int m = cost.cols();
+  const double inf = std::numeric_limits<double>::infinity();
+  u_.assign(n + 1, 0.0);
+  v_.assign(m + 1, 0.0);
+  column_rows.assign(m + 1, 0);
+  way_.assign(m + 1, 0);
+
+  for(int i = 1; i <= n; ++i)
+  {
+    column_rows[0] = i;
+    int j0 = 0;
+    min_slack_.assign(m + 1, inf);
+    used_.assign(m + 1, 0);
+    do
+    {
+      used_[j0] = 1;
+      int i0 = column_rows[j0];
+      double delta = inf;
+      int j1 = 0;
+      for(int j = 1; j <= m; ++j)
+      {
+        if(used_[j])
+          continue;
+        double slack = cost(i0 - 1, j - 1) - u_[i0] - v_[j];
+        if(slack < min_slack_[j])
+        {
+          min_slack_[j] = slack;
+          way_[j] = j0;
+        }
+        if(min_slack_[j] < delta)
+        {
+          delta = min_slack_[j];
+          j1 = j;
+        }
+      }
+      for(int j = 0; j <= m; ++j)
+      {
+        if(used_[j])
+        {
+          u_[column_rows[j]] += delta;
+          v_[j] -= delta;
+        }
+        else
+          min_slack_[j] -= delta;
+      }
+      j0 = j1;
+    } while(column_rows[j0] != 0);
+
+    // flip the augmenting path
+    do
+    {
+      int j1 = way_[j0];
+      column_rows[j0] = column_rows[j1];
+      j0 = j1;
+    } while(j0 != 0);
+  }
+}
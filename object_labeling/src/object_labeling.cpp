@@ -1,15 +1,29 @@
 #include <object_labeling/object_labeling.h>
 
+#include <algorithm>
+#include <cstring>
+
 ObjectLabeling::ObjectLabeling(
     const std::string& objects_cloud_topic_, 
     const std::string& camera_info_topic,
     const std::string& camera_frame) :
-  is_cloud_updated_(false),
   has_camera_info_(false),
   objects_cloud_topic_(objects_cloud_topic_),
   camera_info_topic_(camera_info_topic),
   camera_frame_(camera_frame),
-  K_(Eigen::Matrix3d::Zero())
+  K_(Eigen::Matrix3d::Zero()),
+  labeled_objects_color_(false),
+  max_detection_offset_(0.5),
+  detection_wait_(0.5),
+  clustering_method_(GRID),
+  cluster_tolerance_(0.02f),
+  min_cluster_size_(100),
+  max_cluster_size_(2500),
+  match_projection_(CLUSTER_POINTS),
+  projection_max_points_(200),
+  match_max_distance_(50.0),
+  match_iou_weight_(0.5),
+  latency_monitor_("object_labeling: latency")
 {
 }
 
@@ -17,10 +31,105 @@ ObjectLabeling::~ObjectLabeling()
 {
 }
 
-bool ObjectLabeling::initalize(ros::NodeHandle& nh)
+bool ObjectLabeling::initalize(ros::NodeHandle& nh, std::shared_ptr<TransformCache> transform_cache)
 {
+  // clustering parameters (optional)
+  std::string clustering_method;
+  ros::param::param<std::string>("clustering_method", clustering_method, "grid");
+  ros::param::param<float>("cluster_tolerance", cluster_tolerance_, cluster_tolerance_);
+  ros::param::param<int>("min_cluster_size", min_cluster_size_, min_cluster_size_);
+  ros::param::param<int>("max_cluster_size", max_cluster_size_, max_cluster_size_);
+  if(clustering_method == "grid")
+    clustering_method_ = GRID;
+  else if(clustering_method == "kdtree")
+    clustering_method_ = KDTREE;
+  else
+  {
+    ROS_ERROR_STREAM("Unknown clustering_method " << clustering_method << ", use grid or kdtree");
+    return false;
+  }
+  if(!(cluster_tolerance_ > 0.0f) || min_cluster_size_ < 1 || min_cluster_size_ > max_cluster_size_)
+  {
+    ROS_ERROR_STREAM("ObjectLabeling: cluster_tolerance has to be positive and "
+      "1 <= min_cluster_size <= max_cluster_size");
+    return false;
+  }
+  // matching parameters (optional)
+  std::string match_projection;
+  ros::param::param<std::string>("match_projection", match_projection, "points");
+  ros::param::param<int>("projection_max_points", projection_max_points_, projection_max_points_);
+  ros::param::param<double>("match_max_distance", match_max_distance_, match_max_distance_);
+  ros::param::param<double>("match_iou_weight", match_iou_weight_, match_iou_weight_);
+  if(match_projection == "points")
+    match_projection_ = CLUSTER_POINTS;
+  else if(match_projection == "bounding_box")
+    match_projection_ = BOUNDING_BOX;
+  else
+  {
+    ROS_ERROR_STREAM("Unknown match_projection " << match_projection << ", use points or bounding_box");
+    return false;
+  }
+  if(!(match_max_distance_ > 0.0) || !(match_iou_weight_ >= 0.0 && match_iou_weight_ <= 1.0) ||
+     projection_max_points_ < 1)
+  {
+    ROS_ERROR_STREAM("ObjectLabeling: match_max_distance has to be positive, match_iou_weight in [0, 1] "
+      "and projection_max_points at least 1");
+    return false;
+  }
+
+  // detection history (optional)
+  int detection_history_size = 10;
+  ros::param::param<int>("detection_history_size", detection_history_size, detection_history_size);
+  ros::param::param<double>("max_detection_offset", max_detection_offset_, max_detection_offset_);
+  ros::param::param<double>("detection_wait", detection_wait_, detection_wait_);
+  if(detection_history_size < 1 || !(max_detection_offset_ >= 0.0) || !(detection_wait_ >= 0.0))
+  {
+    ROS_ERROR_STREAM("ObjectLabeling: detection_history_size has to be at least 1, max_detection_offset "
+      "and detection_wait not negative");
+    return false;
+  }
+  detection_history_.setCapacity(detection_history_size);
+
+  // tracking parameters (optional)
+  std::string tracking_model;
+  double tracking_gate = 0.1;
+  double tracking_max_age = 2.0;
+  ros::param::param<std::string>("tracking_model", tracking_model, "static");
+  ros::param::param<double>("tracking_gate", tracking_gate, tracking_gate);
+  ros::param::param<double>("tracking_max_age", tracking_max_age, tracking_max_age);
+  if(tracking_model == "static")
+    tracker_.setMotionModel(ObjectTracker::STATIC);
+  else if(tracking_model == "constant_velocity")
+    tracker_.setMotionModel(ObjectTracker::CONSTANT_VELOCITY);
+  else
+  {
+    ROS_ERROR_STREAM("Unknown tracking_model " << tracking_model << ", use static or constant_velocity");
+    return false;
+  }
+  if(!(tracking_gate > 0.0) || !(tracking_max_age >= 0.0))
+  {
+    ROS_ERROR_STREAM("ObjectLabeling: tracking_gate has to be positive and tracking_max_age not negative");
+    return false;
+  }
+  tracker_.setGate(tracking_gate);
+  tracker_.setMaxAge(tracking_max_age);
+
+  // labeled objects without color by default, saves a fifth of the bandwidth
+  ros::param::param<bool>("labeled_objects_color", labeled_objects_color_, labeled_objects_color_);
+
+  grid_clustering_.setClusterTolerance(cluster_tolerance_);
+  grid_clustering_.setMinClusterSize(min_cluster_size_);
+  grid_clustering_.setMaxClusterSize(max_cluster_size_);
+
+  transform_cache_ = transform_cache ? transform_cache : std::make_shared<TransformCache>(nh);
+
   //#>>>>TODO: subscribe to objects pointcloud published by the plane_segmentation_node
-  object_point_cloud_sub_ = nh.subscribe(objects_cloud_topic_, 10, &ObjectLabeling::cloudCallback, this);
+  // clouds wait in the tf filter until the camera pose at their stamp is known
+  object_point_cloud_sub_.subscribe(nh, objects_cloud_topic_, 1);
+  tf_filter_.reset(new tf2_ros::MessageFilter<PointCloud>(
+    object_point_cloud_sub_, transform_cache_->buffer(), camera_frame_, 5, nh));
+  tf_filter_->registerCallback(boost::bind(&ObjectLabeling::cloudCallback, this, _1));
+  tf_filter_->registerFailureCallback(boost::bind(&ObjectLabeling::cloudDroppedCallback, this, _1, _2));
   //#>>>>TODO: subscribe to bounding boxes from yolo (object_labeling_node)
   object_detections_sub_ = nh.subscribe("/darknet_ros/bounding_boxes", 10, &ObjectLabeling::detectionCallback, this);
   //#>>>>TODO: subscribe to camera info from robot to obtain the camera matrix K
@@ -29,14 +138,32 @@ bool ObjectLabeling::initalize(ros::NodeHandle& nh)
   //#>>>>TODO: publish the labled objects as PointCloudl type (see typedefs in header)
   labeled_object_cloud_pub_ = nh.advertise<sensor_msgs::PointCloud2>("/labeled_object_point_cloud", 1);
 
+  // the same points sorted by object, one object is a slice of the cloud
+  labeled_objects_pub_ = nh.advertise<object_labeling::LabeledObjects>("/labeled_objects", 1);
+
   // publish the LABELED object names as visulaization marker (http://wiki.ros.org/rviz/DisplayTypes/Marker)
   text_marker_pub_ = nh.advertise<visualization_msgs::MarkerArray>("/text_markers", 1);
 
   // DEBUG
   centroid_pub_ = nh.advertise<geometry_msgs::PointStamped>("cluster_centroid", 1);
 
+  // per stage latencies
+  diagnostics_pub_ = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+
+  // timing stages, registered in the order of the Stage enum
+  latency_monitor_.addStage("clustering");
+  latency_monitor_.addStage("centroids");
+  latency_monitor_.addStage("tf_lookup");
+  latency_monitor_.addStage("matching");
+  latency_monitor_.addStage("relabel");
+  latency_monitor_.addStage("publish");
+  latency_monitor_.addStage("update");
+  latency_monitor_.addStage("stamp_to_publish");
+  latency_monitor_.addStage("detection_offset");
+  latency_monitor_.addStage("tracking");
+  latency_monitor_.addStage("detection_wait");
+
   // init internal pointclouds for processing (again pcl uses pointers)
-  object_point_cloud_.reset(new PointCloud);    // holds unlabled object point cloud
   labeled_point_cloud_.reset(new PointCloudl);  // holds labled object point cloud
 
   //#>>>>TODO: setup a mapping from class names the ones given by yolo (see yolo bounding_boxes message for classes)
@@ -47,32 +174,125 @@ bool ObjectLabeling::initalize(ros::NodeHandle& nh)
   dict_["Pringles"] = 2;
   // ... bananna, cup, apple, ...
 
+  // names of the class labels for the text markers
+  for(const auto& entry : dict_)
+  {
+    if(class_names_.size() <= static_cast<size_t>(entry.second))
+      class_names_.resize(entry.second + 1);
+    class_names_[entry.second] = entry.first;
+  }
+
   return true;
 }
 
+bool ObjectLabeling::waitForCloud(const ros::Duration& timeout)
+{
+  // a cloud waiting for its detections is checked again on new detections, at least every timeout
+  if(pending_cloud_)
+  {
+    detection_slot_.waitFor(timeout.toSec());
+    return true;
+  }
+  return cloud_slot_.waitFor(timeout.toSec());
+}
+
 void ObjectLabeling::update(const ros::Time& time)
 {
-  // camera info and point cloud available
-  if(is_cloud_updated_ && has_camera_info_)
+  // pick up the latest camera info
+  sensor_msgs::CameraInfoConstPtr camera_info_msg;
+  if(camera_info_slot_.take(camera_info_msg))
+    setCameraInfo(*camera_info_msg);
+
+  ros::Time detection_stamp;
+  if(detection_slot_.take(detection_stamp))
+    newest_detection_stamp_ = detection_stamp;
+
+  // camera info and point cloud available (clouds before the camera info are
+  // dropped), newer clouds wait in the slot while one waits for its detections
+  CloudConstPtr cloud_msg;
+  if(!pending_cloud_ && cloud_slot_.take(cloud_msg) && has_camera_info_)
+  {
+    pending_cloud_ = cloud_msg;
+    pending_since_ = time;
+  }
+
+  // the detector lags behind the cloud by its inference time, the cloud is
+  // labeled once detections of an image at least as new arrived, so the
+  // closest ones are those of its own image, or when the wait expired
+  if(pending_cloud_ && (newest_detection_stamp_ >= pcl_conversions::fromPCL(pending_cloud_->header).stamp ||
+                        time < pending_since_ || (time - pending_since_).toSec() >= detection_wait_))
   {
-    is_cloud_updated_ = false;
+    cloud_msg = pending_cloud_;
+    pending_cloud_.reset();
+    latency_monitor_.record(STAGE_DETECTION_WAIT, std::max(0.0, (time - pending_since_).toSec()));
+
+    ScopedStageTimer update_timer(latency_monitor_, STAGE_UPDATE);
+
+    //#>>>>TODO: convert to pcl and store in object_point_cloud_
+    // already pcl, shared with plane_segmentation within a nodelet manager
+    object_point_cloud_ = cloud_msg;
+
+    // detections of the image closest in time, none if all are too far off
+    ros::Time stamp = pcl_conversions::fromPCL(cloud_msg->header).stamp;
+    darknet_ros_msgs::BoundingBoxesConstPtr detections_msg;
+    if(detection_history_.closest(stamp, ros::Duration(max_detection_offset_), detections_msg, detections_stamp_))
+    {
+      detections_ = detections_msg->bounding_boxes;
+      latency_monitor_.record(STAGE_DETECTION_OFFSET, std::abs((detections_stamp_ - stamp).toSec()));
+    }
+    else
+    {
+      ROS_WARN_STREAM_THROTTLE(5.0, "ObjectLabeling: no detections within " << max_detection_offset_
+        << "s of the cloud at " << stamp);
+      detections_.clear();
+      detections_stamp_ = stamp;
+    }
 
     // label the objects in pointcloud based on 2d bounding boxes 
     if(!labelObjects(object_point_cloud_, labeled_point_cloud_))
       return;
 
-    //#>>>>TODO: publish labeled_point_cloud_ to ros
-    sensor_msgs::PointCloud2 labeled_point_cloud_msg;
-    pcl::toROSMsg(*labeled_point_cloud_, labeled_point_cloud_msg);
-    labeled_object_cloud_pub_.publish(labeled_point_cloud_msg);
+    {
+      ScopedStageTimer timer(latency_monitor_, STAGE_PUBLISH);
+
+      //#>>>>TODO: publish labeled_point_cloud_ to ros
+      if(labeled_object_cloud_pub_.getNumSubscribers() > 0)
+      {
+        sensor_msgs::PointCloud2 labeled_point_cloud_msg;
+        pcl::toROSMsg(*labeled_point_cloud_, labeled_point_cloud_msg);
+        labeled_object_cloud_pub_.publish(labeled_point_cloud_msg);
+      }
 
-    //#>>>>TODO: publish text_markers_ to ros
-    text_marker_pub_.publish(text_markers_);
+      if(labeled_objects_pub_.getNumSubscribers() > 0)
+        labeled_objects_pub_.publish(labeled_objects_);
 
+      //#>>>>TODO: publish text_markers_ to ros
+      if(text_marker_pub_.getNumSubscribers() > 0)
+        text_marker_pub_.publish(text_markers_);
+    }
+    latency_monitor_.record(STAGE_STAMP_TO_PUBLISH, (ros::Time::now() - stamp).toSec());
   }
+
+  publishDiagnostics(time);
 }
 
-bool ObjectLabeling::labelObjects(CloudPtr& input, CloudPtrl& output)
+void ObjectLabeling::publishDiagnostics(const ros::Time& time)
+{
+  if(time - last_diagnostics_time_ < ros::Duration(1.0))
+    return;
+  last_diagnostics_time_ = time;
+
+  diagnostic_msgs::DiagnosticStatus latency;
+  latency_monitor_.getStatus(latency);
+  latency.hardware_id = camera_frame_;
+
+  diagnostic_msgs::DiagnosticArray diagnostics;
+  diagnostics.header.stamp = time;
+  diagnostics.status.push_back(latency);
+  diagnostics_pub_.publish(diagnostics);
+}
+
+bool ObjectLabeling::labelObjects(const CloudConstPtr& input, CloudPtrl& output)
 {
   //#>>>>GOAL: Split input pointcloud into seperate blobs, compute centroid,
   //#>>>>GOAL: project centorid into the camera image and match with bounding box
@@ -84,37 +304,45 @@ bool ObjectLabeling::labelObjects(CloudPtr& input, CloudPtrl& output)
   //#>>>>TODO: Use EuclideanClusterExtraction to seperate the pointcloud into clusters
   //#>>>>Hint: https://pcl.readthedocs.io/projects/tutorials/en/master/cluster_extraction.html?highlight=EuclideanClusterExtraction
 
-  ROS_INFO("Setting up KDTree.");
-  // create the KD tree for the search method of the clustring
-  pcl::search::KdTree<PointT>::Ptr tree(new pcl::search::KdTree<PointT>);
-  tree->setInputCloud(input);
+  LatencyMonitor::Clock::time_point stage_start = LatencyMonitor::Clock::now();
 
   // holds the extracted cluster indices (just a integer for identifiction)
-  std::vector<pcl::PointIndices> cluster_indices;
-  pcl::EuclideanClusterExtraction<PointT> ec;
-  ec.setClusterTolerance(0.02); // 0.02m
-  ec.setMinClusterSize(100);
-  ec.setMaxClusterSize(2500);
-  ec.setSearchMethod(tree);
-  ec.setInputCloud(input);
-  ec.extract(cluster_indices);
+  // and the statistics of each cluster, both keep their capacity between frames
+  std::vector<pcl::PointIndices>& cluster_indices = cluster_indices_;
+  std::vector<ClusterStatistics>& cluster_statistics = cluster_statistics_;
+  if(clustering_method_ == GRID)
+  {
+    // same clusters, without building a tree, statistics summed up on the way
+    grid_clustering_.extract(*input, cluster_indices, cluster_statistics);
+  }
+  else
+  {
+    ROS_INFO("Setting up KDTree.");
+    // create the KD tree for the search method of the clustring
+    pcl::search::KdTree<PointT>::Ptr tree(new pcl::search::KdTree<PointT>);
+    tree->setInputCloud(input);
+
+    pcl::EuclideanClusterExtraction<PointT> ec;
+    ec.setClusterTolerance(cluster_tolerance_);
+    ec.setMinClusterSize(min_cluster_size_);
+    ec.setMaxClusterSize(max_cluster_size_);
+    ec.setSearchMethod(tree);
+    ec.setInputCloud(input);
+    ec.extract(cluster_indices);
+  }
+  stage_start = latency_monitor_.lap(STAGE_CLUSTERING, stage_start);
 
   ROS_INFO("Obtaining centroids.");
   //#>>>>TODO: Iterate over each cluster and compute its centroid point (= mean)
   //#>>>>TODO: Push the centroid into the vector of centroids
-  std::vector<Eigen::Vector3d> centroids;
-  for (const auto& cluster : cluster_indices)
-  {
-    pcl::PointCloud<PointT>::Ptr cloud_cluster(new pcl::PointCloud<PointT>);
-    for (const auto& idx: cluster.indices)
-    {
-      cloud_cluster->push_back(input->points[idx]);
-    }
-    Eigen::Vector4d centroid;
-    pcl::compute3DCentroid(*cloud_cluster, centroid);
-    centroids.push_back(centroid.head<3>());
+  // straight from the index lists, the clusters are not copied
+  if(clustering_method_ == KDTREE)
+    ClusterStatistics::compute(*input, cluster_indices, cluster_statistics);
 
-    // Publish the centroid as a PointStamped message
+  // Publish the centroids as PointStamped messages (debug, only if somebody listens)
+  for (size_t i = 0; i < cluster_statistics.size() && centroid_pub_.getNumSubscribers() > 0; ++i)
+  {
+    const Eigen::Vector3d& centroid = cluster_statistics[i].centroid;
     geometry_msgs::PointStamped centroid_msg;
     centroid_msg.header.frame_id = "base_footprint";
     centroid_msg.header.stamp = ros::Time::now();
@@ -125,6 +353,8 @@ bool ObjectLabeling::labelObjects(CloudPtr& input, CloudPtrl& output)
     centroid_pub_.publish(centroid_msg);
   }
 
+  stage_start = latency_monitor_.lap(STAGE_CENTROIDS, stage_start);
+
   // Next we need to find the pixel coordinates of the centroids within the 2d
   // camera image. This projection is handled by the camera matrix
   // First, the centorids need to be transformed from the pointcloud frame into the
@@ -136,19 +366,24 @@ bool ObjectLabeling::labelObjects(CloudPtr& input, CloudPtrl& output)
   //#>>>>TODO: Convert the tf::StampedTransform into an Eigen::Affine3d
   //#>>>>Hint: tf::transformTFToEigen(...) can do the job
   ROS_INFO("Transforming point cloud into camera frame.");
+  // camera pose when the image of the detections was taken, the cloud (in
+  // base frame) is projected into that image. The pose at the cloud stamp
+  // is always available (tf filter) and used if the other one is not.
   Eigen::Affine3d T_base_camera; // = ?;
-  tf::StampedTransform transform;
-  tfListener_.lookupTransform("base_footprint", camera_frame_, ros::Time(0), transform);
-  tf::transformTFToEigen(transform, T_base_camera);
+  std_msgs::Header header = pcl_conversions::fromPCL(input->header);
+  if(!transform_cache_->lookup(header.frame_id, camera_frame_, detections_stamp_, T_base_camera) &&
+     !transform_cache_->lookup(header.frame_id, camera_frame_, header.stamp, T_base_camera))
+    return false;
+  stage_start = latency_monitor_.lap(STAGE_TF_LOOKUP, stage_start);
 
   //#>>>>TODO: Transform the centorids into the camera frame by multiplying them 
   //#>>>>TODO: with the transformation that takes a point in the pointcloud frame and turns it
   //#>>>>TODO: into a point in the camera frame. Do this for all centroids.
   std::vector<Eigen::Vector3d> centroids_camera;
   Eigen::Affine3d T_camera_base = T_base_camera.inverse();
-  for (const auto& centroid : centroids)
+  for (const auto& statistics : cluster_statistics)
   {
-    centroids_camera.push_back(T_camera_base * centroid);
+    centroids_camera.push_back(T_camera_base * statistics.centroid);
   }
 
   //#>>>>TODO: Project the transformed centorids into the camera plane by using the camera matrix K
@@ -156,13 +391,24 @@ bool ObjectLabeling::labelObjects(CloudPtr& input, CloudPtrl& output)
   //#>>>>Hint: To get pixel coordinates in R^2 you need to convert them to homogenous 2d coordinates
   //#>>>>Hint: ( = divide by the last component and drop the one in third component.)
   ROS_INFO("Projecting centroids into the camera plane.");
+  const double inf = std::numeric_limits<double>::infinity();
   std::vector<Eigen::Vector2d> pixel_centroids; // = ?
   for (const auto& centroid : centroids_camera)
   {
+    // behind the camera, never matched
+    if (centroid.z() <= 0.0)
+    {
+      pixel_centroids.emplace_back(inf, inf);
+      continue;
+    }
     Eigen::Vector3d homogenous_coord = K_ * centroid;
     homogenous_coord /= homogenous_coord[2];
     pixel_centroids.emplace_back(homogenous_coord[0], homogenous_coord[1]);
   }
+
+  // image rectangle of each cluster, for the overlap with the detections
+  std::vector<cv::Rect2d> cluster_rects;
+  projectClusters(*input, T_camera_base, cluster_rects);
   
   // Now the centorids of each cluster are given as pixel coordinates in the 2d image
   // plane of the camera. What remains is to find the bounding box that matches to each of 
@@ -174,101 +420,275 @@ bool ObjectLabeling::labelObjects(CloudPtr& input, CloudPtrl& output)
   //#>>>>TODO: If a cluster cant be matched (no bounding boxes left) assign 0 as label
 
   ROS_INFO("Finding best match between centroids and detections.");
-  std::vector<int> assigned_labels(cluster_indices.size(), -1);                  // lables of each centroid
-  std::vector<std::string> assigned_classes(cluster_indices.size(), "unknown"); // class names of each centroid
-
-  for(size_t i = 0; i < detections_.size(); ++i)
-  {
-    // get the bounding box we want to find the closest cenroid 
-    const darknet_ros_msgs::BoundingBox& bounding_box = detections_[i];
-
-    //#>>>>TODO: For all cenroids compute the distance to the boudning box
-    //#>>>>TODO: select the clostes as match and get its index in pixel_centroids
-    int match{-1}; // = ?
-    double closest_distance = std::numeric_limits<double>::max();
-    Eigen::Vector2d bounding_box_centroid{(bounding_box.xmax + bounding_box.xmin)/2.0, (bounding_box.ymax + bounding_box.ymin)/2.0};
-    for (size_t j = 0; j < pixel_centroids.size(); ++j)
-    {
-      double distance = (pixel_centroids[j] - bounding_box_centroid).norm();
-      if (distance < closest_distance)
-      {
-        closest_distance = distance;
-        match = j;
-      }
+  std::vector<int> assigned_labels;                // lables of each centroid
+  std::vector<std::string> assigned_classes;       // class names of each centroid
+  assignDetections(pixel_centroids, cluster_rects, assigned_labels, assigned_classes);
 
-    }
+  stage_start = latency_monitor_.lap(STAGE_MATCHING, stage_start);
 
-    // remember the label of match
-    if(match != -1 && dict_.find(bounding_box.Class) != dict_.end() && closest_distance < 50)
-    {
-      // std::cout << closest_distance << std::endl;
-      assigned_labels[match] = dict_[bounding_box.Class]; // set match to defined class index
-      assigned_classes[match] = bounding_box.Class;       // set match to class name
-    }
-  }
+  // same object as in the last frames, its class is voted over all of them
+  tracker_.update(header.stamp, cluster_statistics, assigned_labels, track_ids_, track_labels_);
+  stage_start = latency_monitor_.lap(STAGE_TRACKING, stage_start);
 
   ROS_INFO("Relabelling point cloud for publishing.");
   // relabel the point cloud
   output->points.clear();
   output->header = input->header;
+  size_t num_points = 0;
+  for(const auto& statistics : cluster_statistics)
+    num_points += statistics.num_points;
+
+  // the outputs are only built for topics with subscribers
+  bool labeled_cloud = labeled_object_cloud_pub_.getNumSubscribers() > 0;
+  bool text_markers = text_marker_pub_.getNumSubscribers() > 0;
+
+  if(labeled_cloud)
+    output->points.reserve(num_points);
 
   PointTl pt;
   size_t i = 0;
   auto cit = cluster_indices.begin();
-  for(; cit != cluster_indices.end(); ++cit, ++i ) 
+  for(; labeled_cloud && cit != cluster_indices.end(); ++cit, ++i ) 
   {
     // relabel all the points inside cluster
     std::vector<int>::const_iterator it = cit->indices.begin();
     for(; it != cit->indices.end(); ++it ) 
     {
-      PointT& cpt = input->points[*it];
+      const PointT& cpt = input->points[*it];
       pt.x = cpt.x;
       pt.y = cpt.y;
       pt.z = cpt.z;
-      pt.label = assigned_labels[i];    // Note: To test clustering without the matching stuff just use pt.lable = i
+      pt.label = track_ids_[i];         // object id, stable across frames
       output->points.push_back( pt );
     }
   }
 
-  // create a text marker that displays the assigned class name (assigned_classes) 
-  // at the 3d position of the corresponding centroid
-  text_markers_.markers.resize(assigned_classes.size());
-  for(size_t i = 0; i < assigned_classes.size(); ++i)
+  // create a text marker that displays the voted class name 10cm above the
+  // corresponding centroid, task_planning (ObjectInfo) takes the centroid
+  // back from the marker position. The marker id is the object id of the
+  // labeled cloud.
+  text_markers_.markers.resize(text_markers ? track_labels_.size() : 0);
+  for(size_t i = 0; i < text_markers_.markers.size(); ++i)
   {
     visualization_msgs::Marker marker;
     marker.type = visualization_msgs::Marker::TEXT_VIEW_FACING;
-    marker.text = assigned_classes[i];
-    marker.pose.position.x = centroids[i].x();
-    marker.pose.position.y = centroids[i].y();
-    marker.pose.position.z = centroids[i].z() + 0.1;
+    marker.text = track_labels_[i] >= 0 ? class_names_[track_labels_[i]] : "unknown";
+    marker.pose.position.x = cluster_statistics[i].centroid.x();
+    marker.pose.position.y = cluster_statistics[i].centroid.y();
+    marker.pose.position.z = cluster_statistics[i].centroid.z() + 0.1;
     marker.color.a = 1.0;
     marker.scale.z = 0.1;
-    marker.id = i;
+    marker.id = track_ids_[i];
+    marker.lifetime = ros::Duration(1.0);   // ids of lost tracks are not reused
     marker.header.frame_id = input->header.frame_id;
     marker.header.stamp = ros::Time::now();
     text_markers_.markers[i] = marker;
   }
+  if(labeled_objects_pub_.getNumSubscribers() > 0)
+    fillLabeledObjects(*input);
+  latency_monitor_.lap(STAGE_RELABEL, stage_start);
 
   return true;
 }
 
+void ObjectLabeling::fillLabeledObjects(const PointCloud& input)
+{
+  const size_t num_clusters = cluster_indices_.size();
+  labeled_objects_.header = pcl_conversions::fromPCL(input.header);
+  labeled_objects_.object_ids.assign(track_ids_.begin(), track_ids_.end());
+  labeled_objects_.object_classes.resize(num_clusters);
+  labeled_objects_.object_offsets.resize(num_clusters + 1);
+  uint32_t num_points = 0;
+  for(size_t i = 0; i < num_clusters; ++i)
+  {
+    labeled_objects_.object_classes[i] = track_labels_[i] >= 0 ? class_names_[track_labels_[i]] : "unknown";
+    labeled_objects_.object_offsets[i] = num_points;
+    num_points += cluster_indices_[i].indices.size();
+  }
+  labeled_objects_.object_offsets[num_clusters] = num_points;
+
+  // x y z label [rgb], packed without padding
+  sensor_msgs::PointCloud2& cloud = labeled_objects_.cloud;
+  cloud.header = labeled_objects_.header;
+  sensor_msgs::PointCloud2Modifier modifier(cloud);
+  if(labeled_objects_color_)
+    modifier.setPointCloud2Fields(5,
+      "x", 1, sensor_msgs::PointField::FLOAT32,
+      "y", 1, sensor_msgs::PointField::FLOAT32,
+      "z", 1, sensor_msgs::PointField::FLOAT32,
+      "label", 1, sensor_msgs::PointField::UINT32,
+      "rgb", 1, sensor_msgs::PointField::FLOAT32);
+  else
+    modifier.setPointCloud2Fields(4,
+      "x", 1, sensor_msgs::PointField::FLOAT32,
+      "y", 1, sensor_msgs::PointField::FLOAT32,
+      "z", 1, sensor_msgs::PointField::FLOAT32,
+      "label", 1, sensor_msgs::PointField::UINT32);
+  modifier.resize(num_points);
+  cloud.is_dense = true;
+
+  uint8_t* out = cloud.data.data();
+  for(size_t i = 0; i < num_clusters; ++i)
+  {
+    const uint32_t id = track_ids_[i];
+    for(int idx : cluster_indices_[i].indices)
+    {
+      const PointT& pt = input.points[idx];
+      std::memcpy(out, &pt.x, 3 * sizeof(float));
+      std::memcpy(out + 12, &id, sizeof(uint32_t));
+      if(labeled_objects_color_)
+        std::memcpy(out + 16, &pt.rgb, sizeof(float));
+      out += cloud.point_step;
+    }
+  }
+}
+
+
+void ObjectLabeling::projectClusters(const PointCloud& input, const Eigen::Affine3d& T_camera_base,
+                                     std::vector<cv::Rect2d>& cluster_rects)
+{
+  const float inf = std::numeric_limits<float>::infinity();
+  const size_t num_clusters = cluster_statistics_.size();
+  cluster_rects.assign(num_clusters, cv::Rect2d());
+
+  // points in the columns of one matrix, cluster by cluster
+  projection_offsets_.resize(num_clusters + 1);
+  size_t num_columns = 0;
+  for(size_t i = 0; i < num_clusters; ++i)
+  {
+    projection_offsets_[i] = num_columns;
+    num_columns += match_projection_ == BOUNDING_BOX ? 8 :
+      std::min(cluster_indices_[i].indices.size(), static_cast<size_t>(projection_max_points_));
+  }
+  projection_offsets_[num_clusters] = num_columns;
+  projection_points_.resize(3, num_columns);
+
+  for(size_t i = 0; i < num_clusters; ++i)
+  {
+    size_t column = projection_offsets_[i];
+    if(match_projection_ == BOUNDING_BOX)
+    {
+      const ClusterStatistics& statistics = cluster_statistics_[i];
+      for(int corner = 0; corner < 8; ++corner, ++column)
+      {
+        projection_points_.col(column) << (corner & 1 ? statistics.max.x() : statistics.min.x()),
+                                          (corner & 2 ? statistics.max.y() : statistics.min.y()),
+                                          (corner & 4 ? statistics.max.z() : statistics.min.z());
+      }
+      continue;
+    }
+
+    // evenly spread over the cluster, the indices follow the cloud layout
+    const std::vector<int>& indices = cluster_indices_[i].indices;
+    size_t count = projection_offsets_[i + 1] - projection_offsets_[i];
+    for(size_t k = 0; k < count; ++k, ++column)
+      projection_points_.col(column) = input.points[indices[k * indices.size() / count]].getVector3fMap();
+  }
+
+  // one product for all clusters: homogenous pixels = K * (R * p + t)
+  Eigen::Matrix3f KR = (K_ * T_camera_base.linear()).cast<float>();
+  Eigen::Vector3f Kt = (K_ * T_camera_base.translation()).cast<float>();
+  projected_points_.noalias() = KR * projection_points_;
+  projected_points_.colwise() += Kt;
+
+  for(size_t i = 0; i < num_clusters; ++i)
+  {
+    // the box needs all corners in front of the camera, points behind it are skipped
+    Eigen::Vector2f rect_min = Eigen::Vector2f::Constant(inf);
+    Eigen::Vector2f rect_max = Eigen::Vector2f::Constant(-inf);
+    bool visible = true;
+    for(size_t column = projection_offsets_[i]; column < projection_offsets_[i + 1]; ++column)
+    {
+      float depth = projected_points_(2, column);
+      if(depth <= 0.0f)
+      {
+        visible = match_projection_ != BOUNDING_BOX;
+        continue;
+      }
+      Eigen::Vector2f pixel = projected_points_.col(column).head<2>() / depth;
+      rect_min = rect_min.cwiseMin(pixel);
+      rect_max = rect_max.cwiseMax(pixel);
+    }
+    if(visible && rect_min.x() <= rect_max.x())
+      cluster_rects[i] = cv::Rect2d(rect_min.x(), rect_min.y(), rect_max.x() - rect_min.x(), rect_max.y() - rect_min.y());
+  }
+}
+
+void ObjectLabeling::assignDetections(const std::vector<Eigen::Vector2d>& pixel_centroids,
+                                      const std::vector<cv::Rect2d>& cluster_rects,
+                                      std::vector<int>& labels, std::vector<std::string>& classes)
+{
+  labels.assign(pixel_centroids.size(), -1);
+  classes.assign(pixel_centroids.size(), "unknown");
+
+  // only detections of known classes compete for the clusters
+  known_detections_.clear();
+  for(size_t i = 0; i < detections_.size(); ++i)
+  {
+    if(dict_.find(detections_[i].Class) != dict_.end())
+      known_detections_.push_back(i);
+  }
+  if(known_detections_.empty() || pixel_centroids.empty())
+    return;
 
-void ObjectLabeling::cloudCallback(const sensor_msgs::PointCloud2ConstPtr &msg)
+  // cost in [0, 1], 1 for pairs without overlap beyond the distance limit
+  match_costs_.resize(known_detections_.size(), pixel_centroids.size());
+  for(size_t i = 0; i < known_detections_.size(); ++i)
+  {
+    const darknet_ros_msgs::BoundingBox& bounding_box = detections_[known_detections_[i]];
+    cv::Rect2d box(bounding_box.xmin, bounding_box.ymin,
+                   bounding_box.xmax - bounding_box.xmin, bounding_box.ymax - bounding_box.ymin);
+    Eigen::Vector2d box_center{(bounding_box.xmax + bounding_box.xmin)/2.0, (bounding_box.ymax + bounding_box.ymin)/2.0};
+    for(size_t j = 0; j < pixel_centroids.size(); ++j)
+    {
+      double intersection = (box & cluster_rects[j]).area();
+      double iou = intersection > 0.0 ? intersection / (box.area() + cluster_rects[j].area() - intersection) : 0.0;
+      double distance = (pixel_centroids[j] - box_center).norm();
+      match_costs_(i, j) = match_iou_weight_ * (1.0 - iou) +
+        (1.0 - match_iou_weight_) * std::min(distance / match_max_distance_, 1.0);
+    }
+  }
+
+  // every cluster gets at most one detection and vice versa
+  assignment_.solve(match_costs_, detection_clusters_, 1.0);
+  for(size_t i = 0; i < known_detections_.size(); ++i)
+  {
+    int match = detection_clusters_[i];
+    if(match < 0)
+      continue;
+    const std::string& name = detections_[known_detections_[i]].Class;
+    labels[match] = dict_[name];    // set match to defined class index
+    classes[match] = name;          // set match to class name
+  }
+}
+
+void ObjectLabeling::cloudCallback(const CloudConstPtr &msg)
+{
+  // processed in update(), a frame that was not processed yet is replaced
+  cloud_slot_.publish(msg);
+}
+
+void ObjectLabeling::cloudDroppedCallback(const CloudConstPtr &msg, tf2_ros::FilterFailureReason reason)
 {
-  // convert to pcl
-  is_cloud_updated_ = true;
-  //#>>>>TODO: convert to pcl and store in object_point_cloud_
-  //#>>>>Hint: pcl::fromROSMsg()
-  pcl::fromROSMsg(*msg, *object_point_cloud_);
+  ROS_WARN_STREAM_THROTTLE(1.0, "ObjectLabeling: dropped cloud at " << pcl_conversions::fromPCL(msg->header).stamp
+    << ", no transform to " << camera_frame_ << " (reason " << static_cast<int>(reason) << ")");
 }
 
 void ObjectLabeling::detectionCallback(const darknet_ros_msgs::BoundingBoxesConstPtr &msg)
 {
   //#>>>>TODO: copy the YOLO bounding boxes
-  detections_ = msg->bounding_boxes; // = ?;
+  // the header stamp is the detection time, the image stamp the capture time
+  ros::Time stamp = msg->image_header.stamp.isZero() ? msg->header.stamp : msg->image_header.stamp;
+  detection_history_.push(stamp, msg);
+  detection_slot_.publish(stamp);
 }
 
 void ObjectLabeling::cameraInfoCallback(const sensor_msgs::CameraInfoConstPtr &msg)
+{
+  camera_info_slot_.publish(msg);
+}
+
+void ObjectLabeling::setCameraInfo(const sensor_msgs::CameraInfo &msg)
 {
   if (!has_camera_info_) { ROS_INFO("Recieved camera info msg."); }
 
@@ -280,7 +700,7 @@ void ObjectLabeling::cameraInfoCallback(const sensor_msgs::CameraInfoConstPtr &m
   //#>>>>Hint: http://docs.ros.org/en/melodic/api/sensor_msgs/html/msg/CameraInfo.html
   for(size_t i = 0; i < 9; ++i)
   {
-    K(i) = msg->K[i];
+    K(i) = msg.K[i];
   }
   K_ = K.transpose();
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include <object_labeling/object_tracker.h>
+
+#include <algorithm>
+
+void ObjectTracker::Track::vote(int class_label)
+{
+  if(class_label < 0)
+    return;
+  if(votes.size() <= static_cast<size_t>(class_label))
+    votes.resize(class_label + 1, 0);
+  ++votes[class_label];
+
+  // ties keep the current label
+  if(label < 0 || votes[class_label] > votes[label])
+    label = class_label;
+}
+
+ObjectTracker::ObjectTracker(double gate, double max_age, MotionModel model) :
+  gate_(gate),
+  max_age_(max_age),
+  model_(model),
+  alpha_(0.5),
+  beta_(0.1),
+  next_id_(1)
+{
+}
+
+ObjectTracker::~ObjectTracker()
+{
+}
+
+void ObjectTracker::reset()
+{
+  tracks_.clear();
+  last_stamp_ = ros::Time();
+}
+
+void ObjectTracker::update(const ros::Time& stamp, const std::vector<ClusterStatistics>& statistics,
+                           const std::vector<int>& labels, std::vector<uint32_t>& track_ids,
+                           std::vector<int>& track_labels)
+{
+  // time jump, e.g. a restarted bag
+  if(stamp < last_stamp_)
+    reset();
+  last_stamp_ = stamp;
+
+  // drop the tracks that have not been seen for too long
+  tracks_.erase(std::remove_if(tracks_.begin(), tracks_.end(), [&](const Track& track) {
+    return (stamp - track.stamp).toSec() > max_age_; }), tracks_.end());
+
+  // predicted positions against the cluster centroids
+  const size_t num_clusters = statistics.size();
+  predictions_.resize(tracks_.size());
+  costs_.resize(tracks_.size(), num_clusters);
+  for(size_t i = 0; i < tracks_.size(); ++i)
+  {
+    const Track& track = tracks_[i];
+    predictions_[i] = track.position + track.velocity * (stamp - track.stamp).toSec();
+    for(size_t j = 0; j < num_clusters; ++j)
+      costs_(i, j) = (statistics[j].centroid - predictions_[i]).norm();
+  }
+  assignment_.solve(costs_, track_clusters_, gate_);
+
+  track_ids.assign(num_clusters, 0);
+  track_labels.assign(num_clusters, -1);
+  tracked_.assign(num_clusters, 0);
+  for(size_t i = 0; i < tracks_.size(); ++i)
+  {
+    int j = track_clusters_[i];
+    if(j < 0)
+      continue;
+
+    // alpha beta filter, the velocity only for the constant velocity model
+    Track& track = tracks_[i];
+    double dt = (stamp - track.stamp).toSec();
+    Eigen::Vector3d residual = statistics[j].centroid - predictions_[i];
+    track.position = predictions_[i] + alpha_ * residual;
+    if(model_ == CONSTANT_VELOCITY && dt > 0.0)
+      track.velocity += (beta_ / dt) * residual;
+    track.stamp = stamp;
+    track.vote(labels[j]);
+
+    track_ids[j] = track.id;
+    track_labels[j] = track.label;
+    tracked_[j] = 1;
+  }
+
+  // clusters without a track start a new one
+  for(size_t j = 0; j < num_clusters; ++j)
+  {
+    if(tracked_[j])
+      continue;
+    Track track;
+    track.id = next_id_++;
+    track.position = statistics[j].centroid;
+    track.velocity.setZero();
+    track.stamp = stamp;
+    track.label = -1;
+    track.vote(labels[j]);
+    tracks_.push_back(track);
+
+    track_ids[j] = track.id;
+    track_labels[j] = track.label;
+  }
+}
@@ -0,0 +1,352 @@
+#include <gtest/gtest.h>
+
+#include <object_labeling/grid_clustering.h>
+#include <object_labeling/hungarian_assignment.h>
+#include <object_labeling/object_tracker.h>
+
+#include <pcl/search/kdtree.h>
+#include <pcl/segmentation/extract_clusters.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+typedef GridClustering::PointT PointT;
+typedef GridClustering::PointCloud PointCloud;
+
+namespace {
+
+const double kInf = std::numeric_limits<double>::infinity();
+const float kTolerance = 0.02f;
+const int kMinClusterSize = 30;
+const int kMaxClusterSize = 300;
+
+/**
+ * @brief lowest total cost of all one to one assignments by enumeration,
+ * rows may stay unassigned. Pairs at or above max_cost are not allowed,
+ * each unassigned entry of the smaller side costs max_cost instead.
+ */
+void bruteForce(const Eigen::MatrixXd& cost, double max_cost, int row, int assigned, double sum,
+                std::vector<char>& used, double& best)
+{
+  const int slots = std::min(cost.rows(), cost.cols());
+  if(row == cost.rows())
+  {
+    if(assigned < slots && std::isinf(max_cost))
+      return;
+    best = std::min(best, assigned < slots ? sum + (slots - assigned) * max_cost : sum);
+    return;
+  }
+
+  bruteForce(cost, max_cost, row + 1, assigned, sum, used, best);
+  for(int j = 0; j < cost.cols(); ++j)
+  {
+    if(used[j] || cost(row, j) >= max_cost)
+      continue;
+    used[j] = 1;
+    bruteForce(cost, max_cost, row + 1, assigned + 1, sum + cost(row, j), used, best);
+    used[j] = 0;
+  }
+}
+
+double bruteForce(const Eigen::MatrixXd& cost, double max_cost)
+{
+  std::vector<char> used(cost.cols(), 0);
+  double best = kInf;
+  bruteForce(cost, max_cost, 0, 0, 0.0, used, best);
+  return best;
+}
+
+/**
+ * @brief solve with HungarianAssignment, check the assignment is one to one
+ * and compare it with the enumeration
+ */
+void expectOptimal(HungarianAssignment& solver, const Eigen::MatrixXd& cost, double max_cost)
+{
+  std::vector<int> assignment;
+  double total = solver.solve(cost, assignment, max_cost);
+  ASSERT_EQ(static_cast<size_t>(cost.rows()), assignment.size());
+
+  std::vector<char> used(cost.cols(), 0);
+  int assigned = 0;
+  double sum = 0.0;
+  for(int i = 0; i < cost.rows(); ++i)
+  {
+    int j = assignment[i];
+    if(j < 0)
+      continue;
+    ASSERT_LT(j, cost.cols());
+    EXPECT_FALSE(used[j]) << "column " << j << " assigned twice";
+    EXPECT_LT(cost(i, j), max_cost);
+    used[j] = 1;
+    ++assigned;
+    sum += cost(i, j);
+  }
+  EXPECT_NEAR(sum, total, 1e-9);
+
+  const int slots = std::min(cost.rows(), cost.cols());
+  if(std::isinf(max_cost))
+  {
+    EXPECT_EQ(slots, assigned);
+  }
+  double penalized = assigned < slots ? total + (slots - assigned) * max_cost : total;
+  EXPECT_NEAR(bruteForce(cost, max_cost), penalized, 1e-9)
+    << "cost " << cost.rows() << "x" << cost.cols() << ", max_cost " << max_cost;
+}
+
+/**
+ * @brief boxes of points on a 1cm lattice along the x axis, neighbouring
+ * boxes are either closer than the cluster tolerance (merged) or clearly
+ * apart. Also a few boxes too small for a cluster, non finite points and
+ * shuffled point order.
+ */
+PointCloud::Ptr createBoxes(unsigned int seed)
+{
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> noise(-0.002f, 0.002f);
+  std::uniform_int_distribution<int> size(2, 6);
+  std::bernoulli_distribution merge(0.3);
+  std::bernoulli_distribution invalid(0.02);
+
+  PointCloud::Ptr cloud(new PointCloud);
+  float x0 = 0.0f;
+  for(int box = 0; box < 12; ++box)
+  {
+    // every fourth box is a single row, below the minimum cluster size
+    int nx = size(gen);
+    int ny = box % 4 == 3 ? 1 : size(gen);
+    int nz = box % 4 == 3 ? 1 : size(gen);
+    for(int i = 0; i < nx; ++i)
+    {
+      for(int j = 0; j < ny; ++j)
+      {
+        for(int k = 0; k < nz; ++k)
+        {
+          PointT pt;
+          pt.x = x0 + 0.01f * i + noise(gen);
+          pt.y = 0.01f * j + noise(gen);
+          pt.z = 0.01f * k + noise(gen);
+          if(invalid(gen))
+            pt.x = std::numeric_limits<float>::quiet_NaN();
+          cloud->push_back(pt);
+        }
+      }
+    }
+    x0 += 0.01f * (nx - 1) + (merge(gen) ? 0.012f : 0.05f);
+  }
+  std::shuffle(cloud->points.begin(), cloud->points.end(), gen);
+  cloud->width = cloud->size();
+  cloud->height = 1;
+  cloud->is_dense = false;
+  return cloud;
+}
+
+/**
+ * @brief clusters in a canonical order, size first then first index
+ */
+void sortClusters(std::vector<pcl::PointIndices>& clusters)
+{
+  std::sort(clusters.begin(), clusters.end(), [](const pcl::PointIndices& a, const pcl::PointIndices& b) {
+    if(a.indices.size() != b.indices.size())
+      return a.indices.size() > b.indices.size();
+    return a.indices < b.indices;
+  });
+}
+
+ClusterStatistics cluster(double x, double y, double z)
+{
+  ClusterStatistics statistics;
+  statistics.num_points = 1;
+  statistics.centroid = Eigen::Vector3d(x, y, z);
+  return statistics;
+}
+
+}  // namespace
+
+TEST(HungarianAssignment, matchesBruteForceOnSquareMatrices)
+{
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> value(0.0, 1.0);
+  HungarianAssignment solver;
+
+  for(int n = 1; n <= 6; ++n)
+  {
+    for(int trial = 0; trial < 20; ++trial)
+    {
+      Eigen::MatrixXd cost = Eigen::MatrixXd::NullaryExpr(n, n, [&]() { return value(gen); });
+      expectOptimal(solver, cost, kInf);
+    }
+  }
+}
+
+TEST(HungarianAssignment, matchesBruteForceOnRectangularMatrices)
+{
+  std::mt19937 gen(2);
+  std::uniform_real_distribution<double> value(0.0, 1.0);
+  HungarianAssignment solver;
+
+  for(int rows = 1; rows <= 6; ++rows)
+  {
+    for(int cols = 1; cols <= 6; ++cols)
+    {
+      if(rows == cols)
+        continue;
+      for(int trial = 0; trial < 10; ++trial)
+      {
+        Eigen::MatrixXd cost = Eigen::MatrixXd::NullaryExpr(rows, cols, [&]() { return value(gen); });
+        expectOptimal(solver, cost, kInf);
+      }
+    }
+  }
+}
+
+TEST(HungarianAssignment, matchesBruteForceWithMaxCost)
+{
+  std::mt19937 gen(3);
+  std::uniform_real_distribution<double> value(0.0, 1.0);
+  HungarianAssignment solver;
+
+  for(int rows = 1; rows <= 6; ++rows)
+  {
+    for(int cols = 1; cols <= 6; ++cols)
+    {
+      for(int trial = 0; trial < 10; ++trial)
+      {
+        Eigen::MatrixXd cost = Eigen::MatrixXd::NullaryExpr(rows, cols, [&]() { return value(gen); });
+        expectOptimal(solver, cost, 0.3);
+        expectOptimal(solver, cost, 0.7);
+      }
+    }
+  }
+}
+
+TEST(HungarianAssignment, handlesEmptyMatrices)
+{
+  HungarianAssignment solver;
+  std::vector<int> assignment;
+  EXPECT_EQ(0.0, solver.solve(Eigen::MatrixXd(0, 3), assignment));
+  EXPECT_TRUE(assignment.empty());
+  EXPECT_EQ(0.0, solver.solve(Eigen::MatrixXd(2, 0), assignment));
+  EXPECT_EQ(std::vector<int>(2, -1), assignment);
+}
+
+TEST(GridClustering, matchesEuclideanClusterExtraction)
+{
+  GridClustering clustering(kTolerance, kMinClusterSize, kMaxClusterSize);
+  std::vector<pcl::PointIndices> actual;
+
+  for(unsigned int seed = 0; seed < 10; ++seed)
+  {
+    PointCloud::Ptr cloud = createBoxes(seed);
+
+    std::vector<pcl::PointIndices> expected;
+    pcl::search::KdTree<PointT>::Ptr tree(new pcl::search::KdTree<PointT>);
+    tree->setInputCloud(cloud);
+    pcl::EuclideanClusterExtraction<PointT> ec;
+    ec.setClusterTolerance(kTolerance);
+    ec.setMinClusterSize(kMinClusterSize);
+    ec.setMaxClusterSize(kMaxClusterSize);
+    ec.setSearchMethod(tree);
+    ec.setInputCloud(cloud);
+    ec.extract(expected);
+    ASSERT_GT(expected.size(), 1u);
+
+    // reused output, the clusters of the previous cloud are replaced
+    clustering.extract(*cloud, actual);
+
+    // largest first, the order of equally sized clusters is not defined
+    for(size_t i = 1; i < actual.size(); ++i)
+      EXPECT_GE(actual[i - 1].indices.size(), actual[i].indices.size());
+    for(const pcl::PointIndices& indices : actual)
+      EXPECT_TRUE(std::is_sorted(indices.indices.begin(), indices.indices.end()));
+
+    sortClusters(expected);
+    std::vector<pcl::PointIndices> sorted = actual;
+    sortClusters(sorted);
+    ASSERT_EQ(expected.size(), sorted.size()) << "seed " << seed;
+    for(size_t i = 0; i < expected.size(); ++i)
+      EXPECT_EQ(expected[i].indices, sorted[i].indices) << "seed " << seed << ", cluster " << i;
+  }
+}
+
+TEST(GridClustering, statisticsMatchIndexLists)
+{
+  GridClustering clustering(kTolerance, kMinClusterSize, kMaxClusterSize);
+  PointCloud::Ptr cloud = createBoxes(42);
+
+  std::vector<pcl::PointIndices> clusters;
+  std::vector<ClusterStatistics> statistics;
+  clustering.extract(*cloud, clusters, statistics);
+  ASSERT_EQ(clusters.size(), statistics.size());
+
+  std::vector<ClusterStatistics> expected;
+  ClusterStatistics::compute(*cloud, clusters, expected);
+  for(size_t i = 0; i < clusters.size(); ++i)
+  {
+    EXPECT_EQ(expected[i].num_points, statistics[i].num_points);
+    EXPECT_TRUE(expected[i].centroid.isApprox(statistics[i].centroid, 1e-9));
+    EXPECT_EQ(expected[i].min, statistics[i].min);
+    EXPECT_EQ(expected[i].max, statistics[i].max);
+  }
+}
+
+TEST(ObjectTracker, keepsIdsAndVotedLabels)
+{
+  ObjectTracker tracker(0.1, 2.0, ObjectTracker::CONSTANT_VELOCITY);
+  std::vector<uint32_t> ids;
+  std::vector<int> labels;
+
+  tracker.update(ros::Time(1.0), {cluster(0.0, 0.0, 0.0), cluster(1.0, 0.0, 0.0)}, {0, -1}, ids, labels);
+  ASSERT_EQ(2u, ids.size());
+  EXPECT_NE(ids[0], ids[1]);
+  EXPECT_EQ(0, labels[0]);
+  EXPECT_EQ(-1, labels[1]);
+  const uint32_t first = ids[0], second = ids[1];
+
+  // clusters come in a different order, one object moves slowly and the
+  // detector misses it, the other one keeps being detected as class 2
+  for(int k = 1; k < 10; ++k)
+  {
+    tracker.update(ros::Time(1.0 + 0.1 * k), {cluster(1.0 + 0.01 * k, 0.0, 0.0), cluster(0.02 * k, 0.0, 0.0)},
+                   {2, -1}, ids, labels);
+    EXPECT_EQ(second, ids[0]);
+    EXPECT_EQ(first, ids[1]);
+    EXPECT_EQ(0, labels[1]);
+  }
+  EXPECT_EQ(2, labels[0]);
+  EXPECT_EQ(2u, tracker.size());
+}
+
+TEST(ObjectTracker, gatesAndAgesTracks)
+{
+  ObjectTracker tracker(0.1, 2.0);
+  std::vector<uint32_t> ids;
+  std::vector<int> labels;
+
+  tracker.update(ros::Time(1.0), {cluster(0.0, 0.0, 0.0)}, {1}, ids, labels);
+  const uint32_t first = ids[0];
+
+  // too far from the track, a new object
+  tracker.update(ros::Time(1.1), {cluster(0.5, 0.0, 0.0)}, {-1}, ids, labels);
+  EXPECT_NE(first, ids[0]);
+  EXPECT_EQ(-1, labels[0]);
+  EXPECT_EQ(2u, tracker.size());
+
+  // both tracks are older than the maximum age, ids are not reused
+  tracker.update(ros::Time(5.0), {cluster(0.0, 0.0, 0.0)}, {-1}, ids, labels);
+  EXPECT_GT(ids[0], first);
+  EXPECT_EQ(1u, tracker.size());
+
+  // time jump back resets the tracker
+  const uint32_t last = ids[0];
+  tracker.update(ros::Time(0.5), {cluster(0.0, 0.0, 0.0)}, {-1}, ids, labels);
+  EXPECT_NE(last, ids[0]);
+  EXPECT_EQ(1u, tracker.size());
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -6,6 +6,7 @@
 #include <tf/transform_listener.h>
 #include <tf2/LinearMath/Matrix3x3.h>
 #include <tf2/LinearMath/Quaternion.h>
+#include <geometry_msgs/PolygonStamped.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/point_cloud2_iterator.h>
 #include <trajectory_msgs/JointTrajectory.h>
@@ -31,6 +32,7 @@
 
 #include <Eigen/Dense>
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <limits>
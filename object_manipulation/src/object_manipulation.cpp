@@ -100,51 +100,52 @@ void ObjectManipulation::createPlanningScene(const geometry_msgs::PointStamped&
     target_object_pose.pose.position.z = target_centroid.point.z;
     target_object_pose.pose.orientation.w = 1.0;
 
-    // find the verticies of the plane to avoid collision with
-    //// TODO: can probably just hard code verticies to make it more robust
-    sensor_msgs::PointCloud2ConstPtr plane_verticies = 
-        ros::topic::waitForMessage<sensor_msgs::PointCloud2>(
-            "/table_vertices", nh_, ros::Duration{2.0}
+    // find the oriented rectangle of the plane to avoid collision with
+    geometry_msgs::PolygonStampedConstPtr plane_polygon = 
+        ros::topic::waitForMessage<geometry_msgs::PolygonStamped>(
+            "/table_polygon", nh_, ros::Duration{2.0}
         );
 
 
-    if (plane_verticies != nullptr)
+    if (plane_polygon != nullptr && plane_polygon->polygon.points.size() == 4)
     {
-        sensor_msgs::PointCloud2ConstIterator<float> iter_x(*plane_verticies, "x");
-        sensor_msgs::PointCloud2ConstIterator<float> iter_y(*plane_verticies, "y");
-        sensor_msgs::PointCloud2ConstIterator<float> iter_z(*plane_verticies, "z");
-
-        // you will always only have two points in this point cloud
-        float min_x, min_y, min_z;
-        float max_x, max_y, max_z;
-        
-        min_x = *iter_x;
-        min_y = *iter_y;
-        min_z = *iter_z;
-
-        max_x = *(++iter_x);
-        max_y = *(++iter_y);
-        max_z = *(++iter_z);
+        // the four corners of the rectangle, counter clockwise
+        const std::vector<geometry_msgs::Point32>& corners = plane_polygon->polygon.points;
+        Eigen::Vector3d c0(corners[0].x, corners[0].y, corners[0].z);
+        Eigen::Vector3d c1(corners[1].x, corners[1].y, corners[1].z);
+        Eigen::Vector3d c3(corners[3].x, corners[3].y, corners[3].z);
+
+        Eigen::Vector3d length_axis = c1 - c0;
+        Eigen::Vector3d width_axis = c3 - c0;
+        Eigen::Vector3d center = c0 + 0.5 * (length_axis + width_axis);
+        const double plane_thickness = 0.05;
 
         // Create a plane collision object
         moveit_msgs::CollisionObject plane_collision_object;
-        plane_collision_object.header.frame_id = plane_verticies->header.frame_id;
+        plane_collision_object.header.frame_id = plane_polygon->header.frame_id;
         plane_collision_object.id = "plane";
 
-        // define the pose of the box in the planning scene representing the plane
+        // define the pose of the box in the planning scene representing the plane,
+        // rotated around z with the rectangle, top face at the plane height
+        tf2::Quaternion plane_orientation;
+        plane_orientation.setRPY(0.0, 0.0, std::atan2(length_axis.y(), length_axis.x()));
+
         geometry_msgs::Pose plane_pose;
-        plane_pose.position.x = (max_x + min_x) / 2.0;
-        plane_pose.position.y = (max_y + min_y) / 2.0;
-        plane_pose.position.z = -0.025;
-        plane_pose.orientation.w = 1.0;
+        plane_pose.position.x = center.x();
+        plane_pose.position.y = center.y();
+        plane_pose.position.z = center.z() - plane_thickness / 2.0;
+        plane_pose.orientation.x = plane_orientation.x();
+        plane_pose.orientation.y = plane_orientation.y();
+        plane_pose.orientation.z = plane_orientation.z();
+        plane_pose.orientation.w = plane_orientation.w();
 
         // define the shape of the plane box object
         shape_msgs::SolidPrimitive plane_primitive;
         plane_primitive.type = plane_primitive.BOX;
         plane_primitive.dimensions.resize(3);
-        plane_primitive.dimensions[plane_primitive.BOX_X] = std::abs(max_x - min_x);
-        plane_primitive.dimensions[plane_primitive.BOX_Y] = std::abs(max_y - min_y);
-        plane_primitive.dimensions[plane_primitive.BOX_Z] = 0.05;
+        plane_primitive.dimensions[plane_primitive.BOX_X] = length_axis.norm();
+        plane_primitive.dimensions[plane_primitive.BOX_Y] = width_axis.norm();
+        plane_primitive.dimensions[plane_primitive.BOX_Z] = plane_thickness;
 
         plane_collision_object.primitives.push_back(plane_primitive);
         plane_collision_object.primitive_poses.push_back(plane_pose);
@@ -323,7 +324,7 @@ bool ObjectManipulation::pickupCallback(object_manipulation::Pickup::Request&  r
     tf_listener_.lookupTransform(
         "base_footprint",
         "head_rgbd_sensor_rgb_frame",
-        req.object_cloud.header.stamp,
+        req.objects.header.stamp,
         T_base_camera
     );
 
@@ -344,15 +345,26 @@ bool ObjectManipulation::pickupCallback(object_manipulation::Pickup::Request&  r
     gpd_ros::CloudSamples gpd_cloud_samples_msg;
     gpd_cloud_samples_msg.cloud_sources = gpd_cloud_msg;
 
-    // create a vector of points for which to search for grasp poses
-    sensor_msgs::PointCloud2ConstIterator<float> iter_x(req.object_cloud, "x");
-    sensor_msgs::PointCloud2ConstIterator<float> iter_y(req.object_cloud, "y");
-    sensor_msgs::PointCloud2ConstIterator<float> iter_z(req.object_cloud, "z");
-    sensor_msgs::PointCloud2ConstIterator<int> iter_label(req.object_cloud, "label");
-
-    for (; iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z, ++iter_label)
+    // create a vector of points for which to search for grasp poses,
+    // the points of the target object are one slice of the cloud
+    const object_labeling::LabeledObjects& objects = req.objects;
+    auto object = std::find(objects.object_ids.begin(), objects.object_ids.end(), req.object_id);
+    if (object != objects.object_ids.end() && 
+        objects.object_offsets.size() == objects.object_ids.size() + 1)
     {
-        if (*iter_label == req.object_id)
+        size_t index = object - objects.object_ids.begin();
+        uint32_t begin = objects.object_offsets[index];
+        uint32_t end = objects.object_offsets[index + 1];
+
+        sensor_msgs::PointCloud2ConstIterator<float> iter_x(objects.cloud, "x");
+        sensor_msgs::PointCloud2ConstIterator<float> iter_y(objects.cloud, "y");
+        sensor_msgs::PointCloud2ConstIterator<float> iter_z(objects.cloud, "z");
+        iter_x += begin;
+        iter_y += begin;
+        iter_z += begin;
+
+        gpd_cloud_samples_msg.samples.reserve(end - begin);
+        for (uint32_t i = begin; i < end; ++i, ++iter_x, ++iter_y, ++iter_z)
         {
             geometry_msgs::Point sample_point;
             sample_point.x = *iter_x;
@@ -361,6 +373,10 @@ bool ObjectManipulation::pickupCallback(object_manipulation::Pickup::Request&  r
             gpd_cloud_samples_msg.samples.push_back(sample_point);
         }
     }
+    else
+    {
+        ROS_WARN_STREAM("Object with id " << req.object_id << " not in the labeled objects.");
+    }
 
     // publish to gpd_ros
     if (gpd_cloud_samples_msg.samples.size() > 0)
@@ -0,0 +1,135 @@
+#ifndef PERCEPTION_COMMON_LATENCY_MONITOR_H
+#define PERCEPTION_COMMON_LATENCY_MONITOR_H
+
+#include <diagnostic_msgs/DiagnosticStatus.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/**
+ * @brief LatencyMonitor, per stage timing of a processing pipeline.
+ * Every stage keeps the last samples in a fixed size ring buffer, so
+ * recording a sample is a single store without heap allocation. Percentiles
+ * (p50, p95, p99) over this window are computed when the status is
+ * requested, which is meant to happen at a low rate (e.g. 1 Hz).
+ *
+ * Stages are registered once during initialization. Not thread safe, all
+ * calls are expected from the processing thread.
+ */
+class LatencyMonitor
+{
+public:
+  typedef std::chrono::steady_clock Clock;    // monotonic clock of all measurements
+
+public:
+  /**
+   * @brief Construct a new LatencyMonitor object
+   *
+   * @param name name of the diagnostic status
+   * @param window number of samples kept per stage
+   */
+  LatencyMonitor(const std::string& name, size_t window = 512);
+
+  /**
+   * @brief Destroy the LatencyMonitor object
+   *
+   */
+  ~LatencyMonitor();
+
+  /**
+   * @brief register a stage
+   *
+   * @param name stage name, used as key prefix in the diagnostic status
+   * @return size_t stage id for record()
+   */
+  size_t addStage(const std::string& name);
+
+  /**
+   * @brief record the duration of one stage execution
+   *
+   * @param stage stage id
+   * @param seconds duration in seconds
+   */
+  void record(size_t stage, double seconds);
+
+  /**
+   * @brief record the time since start for a stage, for consecutive stages
+   * without an enclosing scope
+   *
+   * @param stage stage id
+   * @param start start time of the stage
+   * @return Clock::time_point end time, start of the next stage
+   */
+  Clock::time_point lap(size_t stage, const Clock::time_point& start);
+
+  /**
+   * @brief drop the samples of all stages, e.g. after a warm-up phase
+   *
+   */
+  void reset();
+
+  /**
+   * @brief summary of all stages: sample count, p50, p95, p99 and max in ms
+   *
+   * @param status diagnostic status, level is always OK
+   */
+  void getStatus(diagnostic_msgs::DiagnosticStatus& status);
+
+private:
+  /**
+   * @brief ring buffer of the samples of one stage
+   *
+   */
+  struct Stage
+  {
+    std::string name;                 //!< stage name
+    std::vector<float> samples;       //!< durations in seconds
+    size_t next;                      //!< next write position
+    size_t count;                     //!< number of valid samples
+    unsigned long total;              //!< number of samples since start
+  };
+
+  std::string name_;                  //!< name of the diagnostic status
+  size_t window_;                     //!< samples per stage
+  std::vector<Stage> stages_;         //!< registered stages
+  std::vector<float> sorted_;         //!< scratch buffer for the percentiles
+};
+
+/**
+ * @brief ScopedStageTimer, records the lifetime of the object as one
+ * execution of a stage
+ */
+class ScopedStageTimer
+{
+public:
+  /**
+   * @brief start the timer
+   *
+   * @param monitor monitor that receives the sample
+   * @param stage stage id
+   */
+  ScopedStageTimer(LatencyMonitor& monitor, size_t stage) :
+    monitor_(monitor),
+    stage_(stage),
+    start_(LatencyMonitor::Clock::now())
+  {
+  }
+
+  /**
+   * @brief stop the timer and record the sample
+   *
+   */
+  ~ScopedStageTimer()
+  {
+    std::chrono::duration<double> elapsed = LatencyMonitor::Clock::now() - start_;
+    monitor_.record(stage_, elapsed.count());
+  }
+
+private:
+  LatencyMonitor& monitor_;                   //!< receives the sample
+  size_t stage_;                              //!< stage id
+  LatencyMonitor::Clock::time_point start_;   //!< start time
+};
+
+#endif
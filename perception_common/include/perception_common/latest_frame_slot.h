@@ -0,0 +1,127 @@
+#ifndef PERCEPTION_COMMON_LATEST_FRAME_SLOT_H
+#define PERCEPTION_COMMON_LATEST_FRAME_SLOT_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+/**
+ * @brief LatestFrameSlot, single-producer/single-consumer mailbox that only
+ * keeps the latest value. Used to hand messages from the ros callback thread
+ * to the processing thread.
+ *
+ * Implemented as a lock-free triple buffer: the producer owns the back
+ * buffer, the consumer owns the front buffer and both exchange theirs with
+ * the middle buffer through one atomic. A value that is overwritten before
+ * the consumer took it is dropped (stale frame).
+ *
+ * The mutex/condition variable is only used to let the consumer sleep until
+ * a new value arrives, neither side holds it while touching the buffers.
+ *
+ * @tparam T value type, usually a message ConstPtr
+ */
+template <typename T>
+class LatestFrameSlot
+{
+public:
+  /**
+   * @brief Construct a new empty LatestFrameSlot object
+   *
+   */
+  LatestFrameSlot() :
+    middle_(1),
+    back_(0),
+    front_(2),
+    dropped_(0)
+  {
+  }
+
+  /**
+   * @brief store a new value, replaces a value that was not taken yet.
+   * Must only be called from the producer thread.
+   *
+   * @param value new value
+   */
+  void publish(const T& value)
+  {
+    buffers_[back_] = value;
+
+    // hand the back buffer over to the middle and mark it as fresh
+    uint8_t previous = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel);
+    if(previous & kFresh)
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+    back_ = previous & kIndexMask;
+
+    // empty critical section, orders the notify after a waiting consumer
+    // checked the flag (no lost wakeups)
+    { std::lock_guard<std::mutex> lock(mutex_); }
+    condition_.notify_one();
+  }
+
+  /**
+   * @brief take the latest value if there is a new one, does not block.
+   * Must only be called from the consumer thread.
+   *
+   * @param value latest value
+   * @return true new value available
+   * @return false no new value since the last call
+   */
+  bool take(T& value)
+  {
+    if(!(middle_.load(std::memory_order_acquire) & kFresh))
+      return false;
+
+    // swap the front buffer with the middle one, clears the fresh flag
+    uint8_t previous = middle_.exchange(front_, std::memory_order_acq_rel);
+    front_ = previous & kIndexMask;
+
+    // move out, the slot does not keep a reference to taken values
+    value = std::move(buffers_[front_]);
+    buffers_[front_] = T();
+    return true;
+  }
+
+  /**
+   * @brief block until a new value is available or the timeout expired.
+   * Must only be called from the consumer thread.
+   *
+   * @param timeout maximum waiting time in seconds
+   * @return true new value available
+   * @return false timeout
+   */
+  bool waitFor(double timeout)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return condition_.wait_for(lock, std::chrono::duration<double>(timeout), [this] {
+      return (middle_.load(std::memory_order_acquire) & kFresh) != 0;
+    });
+  }
+
+  /**
+   * @brief number of values that were overwritten before being taken
+   *
+   * @return uint64_t dropped values
+   */
+  uint64_t dropped() const
+  {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  static const uint8_t kIndexMask = 0x03;     //!< bits of the buffer index
+  static const uint8_t kFresh = 0x04;         //!< middle buffer holds a new value
+
+  T buffers_[3];                              //!< triple buffer
+  std::atomic<uint8_t> middle_;               //!< index of the middle buffer + fresh flag
+  uint8_t back_;                              //!< buffer owned by the producer
+  uint8_t front_;                             //!< buffer owned by the consumer
+  std::atomic<uint64_t> dropped_;             //!< stale values overwritten by the producer
+
+  std::mutex mutex_;                          //!< only used for sleeping
+  std::condition_variable condition_;         //!< signals new values
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef PERCEPTION_COMMON_SHARED_BUFFER_POOL_H
+#define PERCEPTION_COMMON_SHARED_BUFFER_POOL_H
+
+#include <vector>
+
+/**
+ * @brief SharedBufferPool, recycles buffers that are handed out as shared
+ * pointers, e.g. clouds published intra-process. A published message must
+ * not change while a subscriber still holds it, so the processing continues
+ * in a buffer nobody else references. Buffers keep their capacity, after a
+ * few frames no allocation is needed anymore.
+ *
+ * The number of buffers is bounded by the messages in flight (subscriber
+ * queues, frames being processed). Not thread safe, acquire() is expected
+ * from the processing thread, subscribers only release references.
+ *
+ * @tparam T buffer type with a shared pointer typedef T::Ptr (pcl clouds, ros messages)
+ */
+template <typename T>
+class SharedBufferPool
+{
+public:
+  typedef typename T::Ptr Ptr;
+
+public:
+  /**
+   * @brief get a buffer only referenced by the pool, allocates a new one if
+   * all are in use. The content is the one of its last use.
+   *
+   * @return Ptr buffer
+   */
+  Ptr acquire()
+  {
+    for(const Ptr& buffer : buffers_)
+    {
+      if(buffer.use_count() == 1)
+        return buffer;
+    }
+    buffers_.push_back(Ptr(new T));
+    return buffers_.back();
+  }
+
+  /**
+   * @brief keep using buffer unless somebody else references it, then
+   * replace it by a free one
+   *
+   * @param buffer buffer acquired from this pool
+   * @param owners references of the caller (including buffer itself)
+   * @return true buffer was replaced
+   * @return false buffer was free
+   */
+  bool reclaim(Ptr& buffer, long owners = 1)
+  {
+    if(buffer.use_count() <= owners + 1)
+      return false;
+    buffer = acquire();
+    return true;
+  }
+
+  size_t size() const { return buffers_.size(); }   //!< buffers allocated so far
+
+private:
+  std::vector<Ptr> buffers_;                          //!< all buffers, the pool holds one reference each
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef PERCEPTION_COMMON_STAMPED_HISTORY_H
+#define PERCEPTION_COMMON_STAMPED_HISTORY_H
+
+#include <ros/time.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief StampedHistory, bounded history of the latest messages of a slow
+ * stream, e.g. object detections, to find the one closest in time to a
+ * message of another stream. Unlike message_filters::Cache the stamp is
+ * passed explicitly, so it can be the capture time of the data (the image
+ * stamp of a detection) instead of the header stamp.
+ *
+ * A ring buffer of fixed capacity, the oldest entry is replaced once it is
+ * full. Stamps are expected in increasing order, an entry older than the
+ * newest one clears the history (time jump, e.g. a restarted bag).
+ *
+ * Thread safe, push() is expected from the callback thread and closest()
+ * from the processing thread.
+ *
+ * @tparam T value type, usually a message ConstPtr
+ */
+template <typename T>
+class StampedHistory
+{
+public:
+  /**
+   * @brief Construct a new StampedHistory object
+   *
+   * @param capacity number of entries kept
+   */
+  StampedHistory(size_t capacity = 10) :
+    entries_(capacity > 0 ? capacity : 1),
+    next_(0),
+    size_(0)
+  {
+  }
+
+  /**
+   * @brief change the number of entries kept, clears the history
+   *
+   * @param capacity number of entries kept
+   */
+  void setCapacity(size_t capacity)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.assign(capacity > 0 ? capacity : 1, Entry());
+    next_ = 0;
+    size_ = 0;
+  }
+
+  /**
+   * @brief add the newest entry, replaces the oldest one if full
+   *
+   * @param stamp time of the entry
+   * @param value entry
+   */
+  void push(const ros::Time& stamp, const T& value)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(size_ > 0 && stamp < entries_[(next_ + entries_.size() - 1) % entries_.size()].stamp)
+      size_ = 0;
+
+    entries_[next_].stamp = stamp;
+    entries_[next_].value = value;
+    next_ = (next_ + 1) % entries_.size();
+    if(size_ < entries_.size())
+      ++size_;
+  }
+
+  /**
+   * @brief entry with the stamp closest to the given one
+   *
+   * @param stamp time to look for
+   * @param max_offset maximum time difference of the entry
+   * @param value closest entry
+   * @param value_stamp time of the closest entry
+   * @return true entry found
+   * @return false history empty or all entries further away than max_offset
+   */
+  bool closest(const ros::Time& stamp, const ros::Duration& max_offset, T& value, ros::Time& value_stamp) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool found = false;
+    ros::Duration best_offset = max_offset;
+    for(size_t i = 0; i < size_; ++i)
+    {
+      const Entry& entry = entries_[(next_ + entries_.size() - 1 - i) % entries_.size()];
+      ros::Duration offset = entry.stamp > stamp ? entry.stamp - stamp : stamp - entry.stamp;
+      // ties go to the newer entry
+      if(offset < best_offset || (!found && offset == best_offset))
+      {
+        best_offset = offset;
+        value = entry.value;
+        value_stamp = entry.stamp;
+        found = true;
+      }
+    }
+    return found;
+  }
+
+  size_t size() const { std::lock_guard<std::mutex> lock(mutex_); return size_; }  //!< number of entries
+
+private:
+  /**
+   * @brief one entry of the ring buffer
+   *
+   */
+  struct Entry
+  {
+    ros::Time stamp;                          //!< time of the entry
+    T value;                                  //!< entry
+  };
+
+  std::vector<Entry> entries_;                //!< ring buffer
+  size_t next_;                               //!< slot of the next entry
+  size_t size_;                               //!< number of valid entries
+
+  mutable std::mutex mutex_;                  //!< guards everything above
+};
+
+#endif
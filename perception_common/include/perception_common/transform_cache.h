@@ -0,0 +1,124 @@
+#ifndef PERCEPTION_COMMON_TRANSFORM_CACHE_H
+#define PERCEPTION_COMMON_TRANSFORM_CACHE_H
+
+#include <ros/ros.h>
+#include <tf2_msgs/TFMessage.h>
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
+
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+/**
+ * @brief TransformCache, stamp exact transform lookups shared by the nodes
+ * of a process. Owns one tf2 buffer and listener, buffer() is meant for
+ * tf2_ros::MessageFilter so messages are only handed on once the transform
+ * at their stamp is available, lookup() then never waits.
+ *
+ * Sensor frames usually hang off a chain of static transforms (optical
+ * frame -> camera link -> head). Edges published on /tf_static are recorded,
+ * the static tail of the source frame is looked up once and memoized, only
+ * the remaining dynamic part goes through the tf2 buffer. Fully static pairs
+ * cost no tf2 lookup at all. The last result per frame pair is kept as well,
+ * so repeated lookups at the same stamp are free.
+ *
+ * Thread safe, lookups can come from several processing threads.
+ */
+class TransformCache
+{
+public:
+  /**
+   * @brief Construct a new TransformCache object, starts listening to tf
+   *
+   * @param nh node handle of the /tf_static subscription
+   * @param cache_time history kept by the tf2 buffer
+   */
+  TransformCache(ros::NodeHandle& nh, const ros::Duration& cache_time = ros::Duration(10.0));
+
+  /**
+   * @brief Destroy the TransformCache object
+   *
+   */
+  ~TransformCache();
+
+  TransformCache(const TransformCache&) = delete;
+  TransformCache& operator=(const TransformCache&) = delete;
+
+  /**
+   * @brief the cache of this process, created on first use and shared by
+   * everyone asking for it, e.g. all nodelets of a manager
+   *
+   * @param nh node handle of the /tf_static subscription (first call only)
+   * @return std::shared_ptr<TransformCache> shared cache
+   */
+  static std::shared_ptr<TransformCache> instance(ros::NodeHandle& nh);
+
+  /**
+   * @brief the tf2 buffer, e.g. for tf2_ros::MessageFilter
+   *
+   * @return tf2_ros::Buffer& buffer
+   */
+  tf2_ros::Buffer& buffer() { return buffer_; }
+
+  /**
+   * @brief transformation of source frame coordinates into target frame
+   * coordinates at the given stamp, never throws
+   *
+   * @param target_frame target frame
+   * @param source_frame source frame
+   * @param stamp time of the transform, ros::Time(0) for the latest
+   * @param T_target_source transformation
+   * @param timeout maximum waiting time for the transform
+   * @return true success
+   * @return false transform not available, the reason is logged (throttled)
+   */
+  bool lookup(const std::string& target_frame, const std::string& source_frame, const ros::Time& stamp,
+              Eigen::Affine3d& T_target_source, const ros::Duration& timeout = ros::Duration(0.0));
+
+  unsigned long lookups() const { return lookups_; }              //!< calls of lookup()
+  unsigned long bufferLookups() const { return buffer_lookups_; } //!< lookups that needed the tf2 buffer
+  unsigned long failures() const { return failures_; }            //!< lookups without transform
+
+private:
+  /**
+   * @brief memoized transformation of a frame pair, the stamp is only
+   * meaningful for dynamic pairs
+   *
+   */
+  struct Entry
+  {
+    ros::Time stamp;                    //!< stamp of the dynamic lookup
+    Eigen::Affine3d T;                  //!< transformation target <- source
+  };
+
+  typedef std::pair<std::string, std::string> FramePair;   // (target, source)
+  typedef std::map<FramePair, Entry, std::less<FramePair>,
+                   Eigen::aligned_allocator<std::pair<const FramePair, Entry> > > EntryMap;
+
+  void staticCallback(const tf2_msgs::TFMessageConstPtr& msg);  //!< record static edges
+  bool bufferLookup(const std::string& target_frame, const std::string& source_frame, const ros::Time& stamp,
+                    const ros::Duration& timeout, Eigen::Affine3d& T_target_source);
+
+private:
+  tf2_ros::Buffer buffer_;                              //!< transform history
+  tf2_ros::TransformListener listener_;                 //!< fills buffer_
+  ros::Subscriber static_sub_;                          //!< records the static edges
+
+  mutable std::mutex mutex_;                            //!< guards everything below
+  std::map<std::string, std::string> static_parents_;   //!< child -> parent of the static transforms
+  EntryMap static_entries_;                             //!< static tail of source frames, (root, source)
+  EntryMap dynamic_entries_;                            //!< last dynamic lookup per (target, root)
+
+  std::atomic<unsigned long> lookups_;                  //!< calls of lookup()
+  std::atomic<unsigned long> buffer_lookups_;           //!< tf2 buffer lookups
+  std::atomic<unsigned long> failures_;                 //!< failed tf2 buffer lookups
+};
+
+#endif
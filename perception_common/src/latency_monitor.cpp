@@ -0,0 +1,108 @@
+#include <perception_common/latency_monitor.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+/**
+ * @brief nearest rank percentile of sorted samples
+ */
+float percentile(const std::vector<float>& sorted, double p)
+{
+  size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+  return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+std::string formatMilliseconds(float seconds)
+{
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.3f", 1e3f * seconds);
+  return buffer;
+}
+
+}  // namespace
+
+LatencyMonitor::LatencyMonitor(const std::string& name, size_t window) :
+  name_(name),
+  window_(std::max<size_t>(window, 1))
+{
+  sorted_.reserve(window_);
+}
+
+LatencyMonitor::~LatencyMonitor()
+{
+}
+
+size_t LatencyMonitor::addStage(const std::string& name)
+{
+  Stage stage;
+  stage.name = name;
+  stage.samples.assign(window_, 0.0f);
+  stage.next = 0;
+  stage.count = 0;
+  stage.total = 0;
+  stages_.push_back(stage);
+  return stages_.size() - 1;
+}
+
+void LatencyMonitor::record(size_t stage, double seconds)
+{
+  Stage& s = stages_[stage];
+  s.samples[s.next] = static_cast<float>(seconds);
+  s.next = (s.next + 1) % window_;
+  s.count = std::min(s.count + 1, window_);
+  ++s.total;
+}
+
+LatencyMonitor::Clock::time_point LatencyMonitor::lap(size_t stage, const Clock::time_point& start)
+{
+  Clock::time_point now = Clock::now();
+  record(stage, std::chrono::duration<double>(now - start).count());
+  return now;
+}
+
+void LatencyMonitor::reset()
+{
+  for(Stage& stage : stages_)
+  {
+    stage.next = 0;
+    stage.count = 0;
+    stage.total = 0;
+  }
+}
+
+void LatencyMonitor::getStatus(diagnostic_msgs::DiagnosticStatus& status)
+{
+  status.name = name_;
+  status.level = diagnostic_msgs::DiagnosticStatus::OK;
+  status.message = "latency in ms over the last " + std::to_string(window_) + " samples";
+  status.values.clear();
+
+  diagnostic_msgs::KeyValue value;
+  for(const Stage& stage : stages_)
+  {
+    value.key = stage.name + " count";
+    value.value = std::to_string(stage.total);
+    status.values.push_back(value);
+    if(stage.count == 0)
+      continue;
+
+    sorted_.assign(stage.samples.begin(), stage.samples.begin() + stage.count);
+    std::sort(sorted_.begin(), sorted_.end());
+
+    value.key = stage.name + " p50";
+    value.value = formatMilliseconds(percentile(sorted_, 0.50));
+    status.values.push_back(value);
+    value.key = stage.name + " p95";
+    value.value = formatMilliseconds(percentile(sorted_, 0.95));
+    status.values.push_back(value);
+    value.key = stage.name + " p99";
+    value.value = formatMilliseconds(percentile(sorted_, 0.99));
+    status.values.push_back(value);
+    value.key = stage.name + " max";
+    value.value = formatMilliseconds(sorted_.back());
+    status.values.push_back(value);
+  }
+}
@@ -0,0 +1,161 @@
+#include <perception_common/transform_cache.h>
+
+#include <tf2/exceptions.h>
+
+TransformCache::TransformCache(ros::NodeHandle& nh, const ros::Duration& cache_time) :
+  buffer_(cache_time),
+  listener_(buffer_),
+  lookups_(0),
+  buffer_lookups_(0),
+  failures_(0)
+{
+  // latched, every static broadcaster sends its transforms once on connect
+  static_sub_ = nh.subscribe("/tf_static", 100, &TransformCache::staticCallback, this);
+}
+
+TransformCache::~TransformCache()
+{
+}
+
+std::shared_ptr<TransformCache> TransformCache::instance(ros::NodeHandle& nh)
+{
+  // released with its last user, a later call creates a new one
+  static std::mutex mutex;
+  static std::weak_ptr<TransformCache> shared;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<TransformCache> cache = shared.lock();
+  if(!cache)
+  {
+    cache = std::make_shared<TransformCache>(nh);
+    shared = cache;
+  }
+  return cache;
+}
+
+bool TransformCache::lookup(const std::string& target_frame, const std::string& source_frame, const ros::Time& stamp,
+                            Eigen::Affine3d& T_target_source, const ros::Duration& timeout)
+{
+  ++lookups_;
+  if(target_frame == source_frame)
+  {
+    T_target_source = Eigen::Affine3d::Identity();
+    return true;
+  }
+
+  // split the chain into the static tail of the source frame and the dynamic rest
+  std::string root;
+  Eigen::Affine3d T_root_source = Eigen::Affine3d::Identity();
+  bool has_static_tail = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // bounded by the number of static edges in case of a (broken) cyclic tree
+    root = source_frame;
+    for(size_t depth = 0; depth < static_parents_.size() && root != target_frame; ++depth)
+    {
+      std::map<std::string, std::string>::const_iterator parent = static_parents_.find(root);
+      if(parent == static_parents_.end())
+        break;
+      root = parent->second;
+    }
+
+    if(root != source_frame)
+    {
+      EntryMap::const_iterator entry = static_entries_.find(FramePair(root, source_frame));
+      if(entry != static_entries_.end())
+      {
+        T_root_source = entry->second.T;
+        has_static_tail = true;
+      }
+    }
+  }
+
+  if(root != source_frame && !has_static_tail)
+  {
+    // first lookup of this static tail, any stamp is valid
+    if(!bufferLookup(root, source_frame, ros::Time(0), timeout, T_root_source))
+      return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = static_entries_[FramePair(root, source_frame)];
+    entry.T = T_root_source;
+  }
+
+  // target within the static chain, nothing dynamic left
+  if(root == target_frame)
+  {
+    T_target_source = T_root_source;
+    return true;
+  }
+
+  // dynamic part, reuse the last result at the same stamp
+  FramePair pair(target_frame, root);
+  Eigen::Affine3d T_target_root;
+  bool cached = false;
+  if(!stamp.isZero())
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    EntryMap::const_iterator entry = dynamic_entries_.find(pair);
+    if(entry != dynamic_entries_.end() && entry->second.stamp == stamp)
+    {
+      T_target_root = entry->second.T;
+      cached = true;
+    }
+  }
+  if(!cached)
+  {
+    if(!bufferLookup(target_frame, root, stamp, timeout, T_target_root))
+      return false;
+    if(!stamp.isZero())
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      Entry& entry = dynamic_entries_[pair];
+      entry.stamp = stamp;
+      entry.T = T_target_root;
+    }
+  }
+
+  T_target_source = T_target_root * T_root_source;
+  return true;
+}
+
+void TransformCache::staticCallback(const tf2_msgs::TFMessageConstPtr& msg)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  for(const geometry_msgs::TransformStamped& transform : msg->transforms)
+  {
+    // tf2 frame ids have no leading slash
+    std::string child = transform.child_frame_id;
+    std::string parent = transform.header.frame_id;
+    if(!child.empty() && child[0] == '/')
+      child.erase(0, 1);
+    if(!parent.empty() && parent[0] == '/')
+      parent.erase(0, 1);
+    static_parents_[child] = parent;
+  }
+
+  // chains might have changed, memoized transforms are looked up again
+  static_entries_.clear();
+  dynamic_entries_.clear();
+}
+
+bool TransformCache::bufferLookup(const std::string& target_frame, const std::string& source_frame, const ros::Time& stamp,
+                                  const ros::Duration& timeout, Eigen::Affine3d& T_target_source)
+{
+  ++buffer_lookups_;
+  geometry_msgs::TransformStamped transform;
+  try
+  {
+    transform = buffer_.lookupTransform(target_frame, source_frame, stamp, timeout);
+  }
+  catch(const tf2::TransformException& e)
+  {
+    ++failures_;
+    ROS_WARN_STREAM_THROTTLE(1.0, "TransformCache: " << e.what());
+    return false;
+  }
+
+  const geometry_msgs::Vector3& t = transform.transform.translation;
+  const geometry_msgs::Quaternion& q = transform.transform.rotation;
+  T_target_source = Eigen::Translation3d(t.x, t.y, t.z) * Eigen::Quaterniond(q.w, q.x, q.y, q.z);
+  return true;
+}
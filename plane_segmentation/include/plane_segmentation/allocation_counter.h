@@ -0,0 +1,55 @@
+#ifndef PLANE_SEGMENTATION_ALLOCATION_COUNTER_H
+#define PLANE_SEGMENTATION_ALLOCATION_COUNTER_H
+
+#include <cstdint>
+
+/**
+ * @brief AllocationCounter, number of heap allocations made by the calling
+ * thread through the global operator new.
+ *
+ * The counting replacements of the global allocation functions are not part
+ * of the plane_segmentation library, a shared library must not swap the
+ * allocator of every process that loads it (and within a nodelet manager
+ * operator new resolves to libstdc++ anyway). Executables that want the
+ * numbers add src/applications/allocation_hooks.cpp to their sources,
+ * without it available() is false and count() stays 0.
+ *
+ * Eigen::aligned_allocator (the point buffers of pcl clouds) calls malloc
+ * directly and is not counted, growth of these buffers has to be checked
+ * through their capacity.
+ */
+class AllocationCounter
+{
+public:
+  /**
+   * @brief counting allocation functions linked into the executable
+   *
+   * @return true count() is measured
+   * @return false count() is always 0
+   */
+  static bool available();
+
+  /**
+   * @brief allocations of the calling thread since it started
+   *
+   * @return uint64_t number of allocations
+   */
+  static uint64_t count();
+
+  /**
+   * @brief count one allocation of the calling thread, called by the
+   * replaced operator new
+   *
+   */
+  static void record();
+
+  /**
+   * @brief mark the counting allocation functions as linked in, called once
+   * during static initialization of allocation_hooks.cpp
+   *
+   * @return true
+   */
+  static bool install();
+};
+
+#endif
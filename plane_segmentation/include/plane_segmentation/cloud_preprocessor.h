@@ -0,0 +1,201 @@
+#ifndef PLANE_SEGMENTATION_CLOUD_PREPROCESSOR_H
+#define PLANE_SEGMENTATION_CLOUD_PREPROCESSOR_H
+
+#include <sensor_msgs/PointCloud2.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <Eigen/Geometry>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief CloudPreprocessor, single pass preprocessing of sensor clouds.
+ * Replaces the chain pcl::VoxelGrid -> pcl_ros::transformPointCloud ->
+ * pcl::PassThrough("z") (-> pcl::CropBox) with one sweep over the input points:
+ * each point is checked against the z limits and the workspace box in base
+ * frame and hashed into its voxel bucket (in sensor frame), only the voxel
+ * centroids are transformed.
+ *
+ * The input can either be a pcl cloud or the byte buffer of a
+ * sensor_msgs::PointCloud2 message, the latter avoids the full resolution
+ * pcl::fromROSMsg copy of the sensor cloud.
+ *
+ * The voxels are hashed into a flat open addressing table, all buffers keep
+ * their capacity between clouds, so a steady stream of similar clouds is
+ * processed without heap allocations.
+ *
+ * The output is identical to the pcl chain: one centroid per occupied voxel,
+ * colors averaged per channel, voxels ordered by their (z, y, x) grid index.
+ * Points are only rejected early if their whole voxel is guaranteed to fail
+ * the z limits or the workspace, so the early rejection never changes a
+ * surviving centroid. The early check costs one transformation per point and
+ * keeps floor, far walls and everything out of reach away from the hashing.
+ */
+class CloudPreprocessor
+{
+public:
+  // pcl pointcloud types
+  typedef pcl::PointXYZRGB PointT;                // The Point Type
+  typedef pcl::PointCloud<PointT> PointCloud;     // The PointCloud Type
+
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /**
+   * @brief Construct a new CloudPreprocessor object
+   *
+   * @param leaf_size edge length of the voxels in meter
+   */
+  CloudPreprocessor(float leaf_size = 0.01f);
+
+  /**
+   * @brief Destroy the CloudPreprocessor object
+   *
+   */
+  ~CloudPreprocessor();
+
+  /**
+   * @brief set the edge length of the voxels
+   *
+   * @param leaf_size edge length in meter
+   */
+  void setLeafSize(float leaf_size);
+
+  /**
+   * @brief set the z limits (in base frame) of the pass filter
+   *
+   * @param low lower limit
+   * @param high upper limit
+   */
+  void setFilterLimits(float low, float high);
+
+  /**
+   * @brief set the workspace box (in base frame), centroids outside are
+   * removed like with pcl::CropBox. Unbounded by default.
+   *
+   * @param min lower corner
+   * @param max upper corner
+   */
+  void setWorkspace(const Eigen::Vector3f& min, const Eigen::Vector3f& max);
+
+  /**
+   * @brief set the transformation from sensor frame to base frame
+   *
+   * @param T_base_sensor pose of the sensor expressed in base frame
+   */
+  void setTransform(const Eigen::Affine3f& T_base_sensor);
+
+  /**
+   * @brief voxelize, transform and filter the input message in one pass
+   *
+   * @param input serialized pointcloud with float32 x, y, z (and optional rgb) fields
+   * @param output preprocessed cloud, expressed in base frame
+   * @return true success
+   * @return false failure (missing or unsupported fields)
+   */
+  bool process(const sensor_msgs::PointCloud2& input, PointCloud& output);
+
+  /**
+   * @brief voxelize, transform and filter the input cloud in one pass
+   *
+   * @param input pointcloud in sensor frame
+   * @param output preprocessed cloud, expressed in base frame
+   * @return true success
+   * @return false failure
+   */
+  bool process(const PointCloud& input, PointCloud& output);
+
+  /**
+   * @brief number of times an internal buffer had to grow, stays constant
+   * once the buffers fit the largest cloud seen so far
+   *
+   * @return uint64_t buffer reallocations
+   */
+  uint64_t reallocations() const;
+
+  size_t inputPoints() const { return input_points_; }        //!< finite points of the last cloud
+  size_t acceptedPoints() const { return accepted_points_; }  //!< points of the last cloud that were voxelized
+
+private:
+  /**
+   * @brief running sums of all points that fall into one voxel
+   *
+   */
+  struct Voxel
+  {
+    int i, j, k;                      //!< grid index
+    float x, y, z;                    //!< sum of coordinates
+    float r, g, b;                    //!< sum of color channels
+    uint32_t count;                   //!< number of points
+  };
+
+  /**
+   * @brief byte offset of a float32 field, -1 if not present
+   *
+   */
+  static int fieldOffset(const sensor_msgs::PointCloud2& input, const std::string& name);
+
+  /**
+   * @brief clear the voxel buckets of the previous cloud, keeps the capacity
+   *
+   */
+  void reset();
+
+  /**
+   * @brief index of the voxel in voxels_, inserts an empty voxel if new
+   *
+   */
+  uint32_t findOrInsert(uint64_t key, int i, int j, int k);
+
+  /**
+   * @brief double the size of the hash table and reinsert all voxels
+   *
+   */
+  void grow();
+
+  /**
+   * @brief pack the grid index into a hash key, 21 bits per axis
+   *
+   */
+  static uint64_t voxelKey(int i, int j, int k);
+
+  /**
+   * @brief combine z limits and workspace into the box and rejection bounds
+   *
+   */
+  void updateBounds();
+
+  /**
+   * @brief reject the point if it is far outside the z limits or the
+   * workspace, else add it to its voxel bucket
+   *
+   */
+  void accumulate(float x, float y, float z, uint32_t rgb);
+
+  /**
+   * @brief transform the voxel centroids and write the ones within
+   * the z limits and the workspace into output, in pcl::VoxelGrid order
+   *
+   */
+  void extract(PointCloud& output);
+
+private:
+  float leaf_size_;                                   //!< voxel edge length
+  float inv_leaf_size_;                               //!< 1 / leaf_size_
+  float pass_low_, pass_high_;                        //!< z limits in base frame
+  Eigen::Vector3f workspace_min_, workspace_max_;     //!< workspace box in base frame
+  Eigen::Vector3f box_min_, box_max_;                 //!< workspace box clipped by the z limits
+  Eigen::Vector3f reject_min_, reject_max_;           //!< box widened by one voxel diagonal
+  Eigen::Affine3f T_base_sensor_;                     //!< sensor to base frame transformation
+  std::vector<uint64_t> keys_;                        //!< open addressing table: voxel key per slot
+  std::vector<uint32_t> slots_;                       //!< open addressing table: index in voxels_ per slot
+  size_t table_mask_;                                 //!< table size - 1, the size is a power of two
+  std::vector<Voxel> voxels_;                         //!< occupied voxels of the current cloud
+  uint64_t reallocations_;                            //!< number of buffer growths
+  size_t input_points_;                               //!< finite points of the last cloud
+  size_t accepted_points_;                            //!< voxelized points of the last cloud
+};
+
+#endif
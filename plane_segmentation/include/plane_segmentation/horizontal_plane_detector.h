@@ -0,0 +1,98 @@
+#ifndef PLANE_SEGMENTATION_HORIZONTAL_PLANE_DETECTOR_H
+#define PLANE_SEGMENTATION_HORIZONTAL_PLANE_DETECTOR_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+
+#include <Eigen/Core>
+
+#include <vector>
+
+/**
+ * @brief HorizontalPlaneDetector, finds the dominant horizontal plane of a
+ * cloud in a gravity aligned frame (z up) without random sampling. The point
+ * heights are binned into a histogram with the inlier distance as bin size,
+ * the densest height is the initial plane. It is refined by least squares
+ * over the points near it, which also recovers small tilts, and rejected if
+ * the refined normal deviates more than the maximum angle from +z. In that
+ * case the next densest height is tried.
+ *
+ * One histogram pass and a few selection passes, O(n) overall.
+ */
+class HorizontalPlaneDetector
+{
+public:
+  // pcl pointcloud types
+  typedef pcl::PointXYZRGB PointT;                // The Point Type
+  typedef pcl::PointCloud<PointT> PointCloud;     // The PointCloud Type
+
+public:
+  /**
+   * @brief Construct a new HorizontalPlaneDetector object
+   *
+   * @param distance_threshold inlier distance and histogram bin size in meter
+   * @param max_angle maximum angle between plane normal and +z in radian
+   */
+  HorizontalPlaneDetector(float distance_threshold = 0.02f, float max_angle = 0.17f);
+
+  /**
+   * @brief Destroy the HorizontalPlaneDetector object
+   *
+   */
+  ~HorizontalPlaneDetector();
+
+  /**
+   * @brief set the maximum point to plane distance of the inliers, also the
+   * bin size of the height histogram
+   *
+   * @param distance distance in meter
+   */
+  void setDistanceThreshold(float distance);
+
+  /**
+   * @brief set the maximum angle between the plane normal and +z
+   *
+   * @param angle angle in radian
+   */
+  void setMaxAngle(float angle);
+
+  /**
+   * @brief detect the dominant horizontal plane in all points
+   *
+   * @param input pointcloud, z axis against gravity
+   * @param inliers indices of the plane points in input
+   * @param coefficients plane coefficients, unit normal pointing up
+   * @return true success
+   * @return false no horizontal plane found
+   */
+  bool detect(const PointCloud& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients);
+
+  /**
+   * @brief detect the dominant horizontal plane in a subset of the points
+   *
+   * @param input pointcloud, z axis against gravity
+   * @param indices points of input to use
+   * @param inliers indices of the plane points in input
+   * @param coefficients plane coefficients, unit normal pointing up
+   * @return true success
+   * @return false no horizontal plane found
+   */
+  bool detect(const PointCloud& input, const std::vector<int>& indices,
+              pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients);
+
+private:
+  bool fit(const PointCloud& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients);
+  void selectInliers(const PointCloud& input, const Eigen::Vector4f& plane, pcl::PointIndices& inliers) const;
+
+private:
+  float distance_threshold_;          //!< inlier distance, histogram bin size
+  float min_normal_z_;                //!< cosine of the maximum angle
+
+  const std::vector<int>* indices_;   //!< indices of the current detect(), nullptr for all points
+  std::vector<float> heights_;        //!< z of the considered points, reused buffer
+  std::vector<int> counts_;           //!< height histogram, reused buffer
+};
+
+#endif
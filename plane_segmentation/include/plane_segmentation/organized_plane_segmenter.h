@@ -0,0 +1,88 @@
+#ifndef PLANE_SEGMENTATION_ORGANIZED_PLANE_SEGMENTER_H
+#define PLANE_SEGMENTATION_ORGANIZED_PLANE_SEGMENTER_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+#include <pcl/features/integral_image_normal.h>
+#include <pcl/segmentation/organized_multi_plane_segmentation.h>
+
+#include <vector>
+
+/**
+ * @brief OrganizedPlaneSegmenter, plane segmentation for organized (image
+ * structured) clouds. Estimates normals with integral images and grows planar
+ * regions with pcl::OrganizedMultiPlaneSegmentation. Works on the full
+ * resolution sensor cloud, no voxelization or search tree is needed.
+ */
+class OrganizedPlaneSegmenter
+{
+public:
+  // pcl pointcloud types
+  typedef pcl::PointXYZRGB PointT;                // The Point Type
+  typedef pcl::PointCloud<PointT> PointCloud;     // The PointCloud Type
+  typedef PointCloud::Ptr CloudPtr;               // The PointCloud Pointer Type
+
+public:
+  /**
+   * @brief Construct a new OrganizedPlaneSegmenter object
+   *
+   */
+  OrganizedPlaneSegmenter();
+
+  /**
+   * @brief Destroy the OrganizedPlaneSegmenter object
+   *
+   */
+  ~OrganizedPlaneSegmenter();
+
+  /**
+   * @brief set the minimum number of points of a plane
+   *
+   * @param min_inliers minimum number of inliers
+   */
+  void setMinInliers(unsigned int min_inliers);
+
+  /**
+   * @brief set the maximum angle between normals of the same plane
+   *
+   * @param angle angle in radian
+   */
+  void setAngularThreshold(double angle);
+
+  /**
+   * @brief set the maximum point to plane distance of the inliers
+   *
+   * @param distance distance in meter
+   */
+  void setDistanceThreshold(double distance);
+
+  /**
+   * @brief set the integral image normal estimation parameters
+   *
+   * @param max_depth_change_factor depth change threshold for object borders
+   * @param smoothing_size size of the smoothing area in pixel
+   */
+  void setNormalEstimation(float max_depth_change_factor, float smoothing_size);
+
+  /**
+   * @brief segment the organized input into planes
+   *
+   * @param input organized pointcloud in sensor frame
+   * @param coefficients plane coefficients (sensor frame), largest plane first
+   * @param inliers inlier indices into input, same order as coefficients
+   * @return true at least one plane found
+   * @return false input not organized or no plane found
+   */
+  bool segment(const CloudPtr& input,
+               std::vector<pcl::ModelCoefficients>& coefficients,
+               std::vector<pcl::PointIndices>& inliers);
+
+private:
+  pcl::IntegralImageNormalEstimation<PointT, pcl::Normal> normal_estimation_;
+  pcl::OrganizedMultiPlaneSegmentation<PointT, pcl::Normal, pcl::Label> segmentation_;
+  pcl::PointCloud<pcl::Normal>::Ptr normals_;     //!< normals of the last input
+};
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef PLANE_SEGMENTATION_PARALLEL_PLANE_RANSAC_H
+#define PLANE_SEGMENTATION_PARALLEL_PLANE_RANSAC_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief ParallelPlaneRansac, RANSAC plane fit with parallel hypothesis
+ * scoring. Hypotheses are sampled in batches and scored by a pool of worker
+ * threads against structure of arrays copies of the points, the inlier
+ * counting loop is branch free so the compiler can vectorize it. After every
+ * batch the number of iterations is bounded adaptively by the best inlier
+ * ratio (probability of an all inlier sample), so easy scenes stop after a
+ * few batches.
+ *
+ * The best hypothesis is refined by least squares over its inliers and the
+ * inliers are selected again, like pcl::SACSegmentation with optimized
+ * coefficients. The result has a unit normal, (a, b, c, d) with
+ * a x + b y + c z + d = 0.
+ *
+ * Like pcl::SACMODEL_PERPENDICULAR_PLANE, the normal can be constrained to
+ * an axis (e.g. gravity). Hypotheses outside the angle are rejected before
+ * scoring, so they cost no inlier counting.
+ *
+ * Not thread safe, segment() is expected from one thread at a time.
+ */
+class ParallelPlaneRansac
+{
+public:
+  // pcl pointcloud types
+  typedef pcl::PointXYZRGB PointT;                // The Point Type
+  typedef pcl::PointCloud<PointT> PointCloud;     // The PointCloud Type
+
+public:
+  /**
+   * @brief Construct a new ParallelPlaneRansac object
+   *
+   * @param num_threads scoring threads including the calling one, 0 for one per core
+   */
+  ParallelPlaneRansac(unsigned int num_threads = 0);
+
+  /**
+   * @brief Destroy the ParallelPlaneRansac object, joins the workers
+   *
+   */
+  ~ParallelPlaneRansac();
+
+  ParallelPlaneRansac(const ParallelPlaneRansac&) = delete;
+  ParallelPlaneRansac& operator=(const ParallelPlaneRansac&) = delete;
+
+  /**
+   * @brief set the number of scoring threads, restarts the workers
+   *
+   * @param num_threads threads including the calling one, 0 for one per core
+   */
+  void setNumThreads(unsigned int num_threads);
+
+  /**
+   * @brief set the maximum point to plane distance of the inliers
+   *
+   * @param distance distance in meter
+   */
+  void setDistanceThreshold(float distance);
+
+  /**
+   * @brief set the axis the plane normals have to be parallel to, used
+   * together with setEpsAngle()
+   *
+   * @param axis axis, e.g. +z of a gravity aligned frame
+   */
+  void setAxis(const Eigen::Vector3f& axis);
+
+  /**
+   * @brief set the maximum angle between plane normal and axis
+   *
+   * @param angle angle in radian, 0 disables the constraint
+   */
+  void setEpsAngle(float angle);
+
+  /**
+   * @brief set the maximum number of hypotheses
+   *
+   * @param max_iterations upper bound of the adaptive iteration count
+   */
+  void setMaxIterations(int max_iterations);
+
+  /**
+   * @brief set the probability of drawing at least one all inlier sample,
+   * determines the adaptive iteration count
+   *
+   * @param probability confidence in (0, 1)
+   */
+  void setProbability(double probability);
+
+  /**
+   * @brief set the number of hypotheses scored in parallel between two
+   * checks of the iteration bound
+   *
+   * @param batch_size hypotheses per batch
+   */
+  void setBatchSize(int batch_size);
+
+  unsigned int numThreads() const { return num_threads_; }    //!< scoring threads including the calling one
+  int iterations() const { return iterations_; }              //!< hypotheses scored in the last segment()
+
+  /**
+   * @brief fit a plane to all points
+   *
+   * @param input pointcloud
+   * @param inliers indices of the plane points in input
+   * @param coefficients plane coefficients, unit normal
+   * @return true success
+   * @return false less than three points or no plane found
+   */
+  bool segment(const PointCloud& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients);
+
+  /**
+   * @brief fit a plane to a subset of the points
+   *
+   * @param input pointcloud
+   * @param indices points of input to use
+   * @param inliers indices of the plane points in input
+   * @param coefficients plane coefficients, unit normal
+   * @return true success
+   * @return false less than three points or no plane found
+   */
+  bool segment(const PointCloud& input, const std::vector<int>& indices,
+               pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients);
+
+private:
+  bool fit(const PointCloud& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients);
+  void startWorkers();                                  //!< spawn num_threads_ - 1 workers
+  void stopWorkers();                                   //!< join all workers
+  void workerLoop(unsigned long last_batch);            //!< wait for batches after last_batch and score them
+  void scoreBatch();                                    //!< score hypotheses until the batch is done
+  int countInliers(const Eigen::Vector4f& plane) const; //!< inliers of one hypothesis (SoA points)
+  bool isValid(const Eigen::Vector3f& normal) const;    //!< normal within the angle to the axis
+  void selectInliers(const Eigen::Vector4f& plane, pcl::PointIndices& inliers) const;
+
+private:
+  typedef std::vector<Eigen::Vector4f, Eigen::aligned_allocator<Eigen::Vector4f> > Planes;
+
+  unsigned int num_threads_;          //!< scoring threads including the calling one
+  float distance_threshold_;          //!< inlier distance
+  Eigen::Vector3f axis_;              //!< unit axis of the normal constraint
+  float eps_angle_;                   //!< maximum angle to the axis, 0 for no constraint
+  int max_iterations_;                //!< upper bound of the hypotheses
+  double probability_;                //!< confidence of the adaptive bound
+  int batch_size_;                    //!< hypotheses per batch
+  int iterations_;                    //!< hypotheses of the last segment()
+
+  // points as structure of arrays, reused between calls
+  std::vector<float> x_, y_, z_;
+  const std::vector<int>* indices_;   //!< indices of the current segment(), nullptr for all points
+
+  // current batch
+  Planes hypotheses_;                 //!< plane hypotheses, zero normal for degenerate samples
+  std::vector<int> scores_;           //!< inliers per hypothesis
+  std::atomic<int> next_hypothesis_;  //!< next unscored hypothesis
+  int batch_hypotheses_;              //!< hypotheses in the current batch
+  std::mt19937 rng_;                  //!< sampling, fixed seed for repeatable results
+
+  // worker pool
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable batch_cv_;  //!< new batch or stop
+  std::condition_variable done_cv_;   //!< a worker finished its part of the batch
+  unsigned long batch_id_;            //!< incremented for every batch
+  unsigned int busy_workers_;         //!< workers still scoring the current batch
+  bool stop_;                         //!< workers have to exit
+};
+
+#endif
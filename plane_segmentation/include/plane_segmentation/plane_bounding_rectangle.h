@@ -0,0 +1,126 @@
+#ifndef PLANE_SEGMENTATION_PLANE_BOUNDING_RECTANGLE_H
+#define PLANE_SEGMENTATION_PLANE_BOUNDING_RECTANGLE_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include <vector>
+
+/**
+ * @brief PlaneBoundingRectangle, oriented minimum area rectangle of plane points.
+ * The inliers are projected into a 2D frame on the plane, the 2D convex hull
+ * is built with the monotone chain algorithm (O(n log n)) and the minimum area
+ * rectangle is found with rotating calipers over the hull edges (O(h)).
+ * Large inlier sets are subsampled before the hull is built.
+ */
+class PlaneBoundingRectangle
+{
+public:
+  // pcl pointcloud types
+  typedef pcl::PointXYZRGB PointT;                // The Point Type
+  typedef pcl::PointCloud<PointT> PointCloud;     // The PointCloud Type
+
+  typedef std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > Points2D;
+  typedef std::vector<Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > Points3D;
+
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /**
+   * @brief Construct a new PlaneBoundingRectangle object
+   *
+   * @param max_points maximum number of inliers used for the hull
+   */
+  PlaneBoundingRectangle(size_t max_points = 5000);
+
+  /**
+   * @brief Destroy the PlaneBoundingRectangle object
+   *
+   */
+  ~PlaneBoundingRectangle();
+
+  /**
+   * @brief set the maximum number of inliers used for the hull, larger
+   * sets are subsampled with a constant stride
+   *
+   * @param max_points maximum number of points
+   */
+  void setMaxPoints(size_t max_points);
+
+  /**
+   * @brief compute hull and minimum area rectangle of the plane points
+   *
+   * @param input pointcloud
+   * @param indices plane inliers in input
+   * @param plane plane coefficients (a, b, c, d) in the frame of input
+   * @return true success
+   * @return false less than three points or invalid plane
+   */
+  bool compute(const PointCloud& input, const std::vector<int>& indices, const Eigen::Vector4f& plane);
+
+  /**
+   * @brief pose of the rectangle in the frame of input: origin at the center
+   * on the plane, x along the length, y along the width, z along the upwards
+   * oriented plane normal
+   *
+   */
+  Eigen::Affine3f pose() const;
+
+  float length() const { return length_; }    //!< extent along the x axis of pose()
+  float width() const { return width_; }      //!< extent along the y axis of pose()
+
+  /**
+   * @brief the four rectangle corners on the plane, counter clockwise
+   *
+   * @param corners corners in the frame of input
+   */
+  void corners(Points3D& corners) const;
+
+  /**
+   * @brief the convex hull vertices on the plane, counter clockwise
+   *
+   * @param hull vertices in the frame of input
+   */
+  void hull(Points3D& hull) const;
+
+  /**
+   * @brief 2D convex hull (monotone chain), collinear points are dropped
+   *
+   * @param points input points, sorted in place
+   * @param hull hull vertices, counter clockwise
+   */
+  static void convexHull(Points2D& points, Points2D& hull);
+
+  /**
+   * @brief minimum area rectangle of a convex polygon (rotating calipers)
+   *
+   * @param hull counter clockwise convex polygon
+   * @param center rectangle center
+   * @param axis unit direction of the length side
+   * @param length extent along axis
+   * @param width extent perpendicular to axis
+   */
+  static void minAreaRectangle(const Points2D& hull,
+                               Eigen::Vector2f& center, Eigen::Vector2f& axis,
+                               float& length, float& width);
+
+private:
+  Eigen::Vector3f toPlane(const Eigen::Vector2f& point) const;   //!< 2D plane coordinates to 3D
+
+private:
+  size_t max_points_;                 //!< maximum number of hull input points
+
+  Eigen::Vector3f origin_;            //!< origin of the 2D frame, on the plane
+  Eigen::Vector3f u_, v_, n_;         //!< 2D frame axes and plane normal
+
+  Points2D points_;                   //!< projected inliers, reused buffer
+  Points2D hull_;                     //!< 2D hull vertices
+  Eigen::Vector2f center_;            //!< 2D rectangle center
+  Eigen::Vector2f axis_;              //!< 2D direction of the length side
+  float length_, width_;              //!< rectangle extent
+};
+
+#endif
@@ -12,7 +12,7 @@
 #include <message_filters/synchronizer.h>
 #include <message_filters/sync_policies/exact_time.h>
 #include <message_filters/sync_policies/approximate_time.h>
-#include <tf/transform_listener.h>
+#include <tf2_ros/message_filter.h>
 
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/image_encodings.h>
@@ -37,9 +37,29 @@
 #include <pcl/segmentation/sac_segmentation.h>
 #include <pcl/filters/passthrough.h>
 #include <pcl_ros/impl/transforms.hpp>
-#include <pcl/surface/convex_hull.h>
 #include <pcl/common/common.h>
 
+#include <perception_common/latest_frame_slot.h>
+#include <perception_common/shared_buffer_pool.h>
+#include <perception_common/transform_cache.h>
+#include <perception_common/latency_monitor.h>
+#include <plane_segmentation/cloud_preprocessor.h>
+#include <plane_segmentation/organized_plane_segmenter.h>
+#include <plane_segmentation/parallel_plane_ransac.h>
+#include <plane_segmentation/horizontal_plane_detector.h>
+#include <plane_segmentation/plane_tracker.h>
+#include <plane_segmentation/plane_bounding_rectangle.h>
+#include <plane_segmentation/scene_accumulator.h>
+#include <plane_segmentation/allocation_counter.h>
+
+#include <array>
+#include <memory>
+
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <geometry_msgs/PolygonStamped.h>
+#include <plane_segmentation/Plane.h>
+#include <plane_segmentation/PlaneArray.h>
+
 /**
  * @brief PlaneSegementation class, splits RGB-D pointclouds into table surface
  * and objects pointcloud. Publishes both new pointlcouds as ros topics
@@ -53,7 +73,77 @@ public:
   typedef pcl::PointCloud<PointT> PointCloud;     // The PointCloud Type
   typedef PointCloud::Ptr CloudPtr;               // The PointCloud Pointer Type
 
+  /**
+   * @brief available plane segmentation methods
+   * 
+   */
+  enum SegmentationMethod
+  {
+    RANSAC,           //!< pcl::SACSegmentation on the preprocessed cloud
+    ORGANIZED,        //!< integral image normals + organized multi plane segmentation on the sensor cloud
+    HEIGHT_HISTOGRAM  //!< horizontal planes only, densest height of the preprocessed cloud + least squares
+  };
+
+  /**
+   * @brief timed processing stages
+   * 
+   */
+  enum Stage
+  {
+    STAGE_INGEST,             //!< message to pcl conversion (not with zero copy ingestion)
+    STAGE_TF_LOOKUP,          //!< sensor pose lookup
+    STAGE_PREPROCESS,         //!< workspace crop, voxel grid, transform and pass filter
+    STAGE_PUBLISH_COMBINED,   //!< publishing of the preprocessed cloud (serialized for remote subscribers only)
+    STAGE_PLANE_FIT,          //!< primary plane (tracking or full segmentation)
+    STAGE_EXTRA_PLANES,       //!< further planes
+    STAGE_OBJECTS,            //!< plane and objects clouds
+    STAGE_ACCUMULATE,         //!< fusion of the objects clouds of the last frames
+    STAGE_PUBLISH,            //!< publishing of plane and objects clouds (serialized for remote subscribers only)
+    STAGE_PLANES,             //!< hulls, rectangles and plane messages
+    STAGE_UPDATE,             //!< whole update
+    STAGE_STAMP_TO_PUBLISH    //!< sensor stamp to publishing of the objects cloud
+  };
+
+  /**
+   * @brief configuration of the processing, defaults are the fallbacks of
+   * the optional rosparams and the values of launch/config/config.yaml
+   * for the required ones
+   * 
+   */
+  struct Parameters
+  {
+    float pre_pass_low, pre_pass_high;    //!< z limits in base frame before segmentation
+    Eigen::Vector3f workspace_min;        //!< lower corner of the processed volume in base frame
+    Eigen::Vector3f workspace_max;        //!< upper corner of the processed volume in base frame
+    float seg_pass_low, seg_pass_high;    //!< height band of the objects above the plane
+    float ransac_threshold;               //!< plane inlier distance
+    bool parallel_ransac;                 //!< ParallelPlaneRansac instead of pcl::SACSegmentation
+    int ransac_threads;                   //!< scoring threads of the parallel RANSAC, 0 for one per core
+    int ransac_max_iterations;            //!< upper bound of the adaptive RANSAC iterations
+    float voxel_leaf_size;                //!< voxel grid leaf size
+    bool zero_copy_ingestion;             //!< voxelize the message buffer instead of converting to pcl
+    SegmentationMethod segmentation_method;   //!< plane segmentation method
+    bool compare_segmentation_methods;    //!< run both methods and report their timings
+    int organized_min_inliers;            //!< minimum plane size of the organized segmentation
+    double organized_angular_threshold;   //!< normal deviation of the organized segmentation in degrees
+    bool plane_tracking;                  //!< track the plane over consecutive frames
+    float tracking_min_inlier_ratio;      //!< inlier ratio below which the tracked plane is lost
+    bool horizontal_planes;               //!< only accept planes with a normal close to base frame +z
+    double max_plane_angle;               //!< angle between normal and +z of horizontal planes in degrees
+    int max_planes;                       //!< maximum number of extracted planes
+    int min_plane_inliers;                //!< minimum number of points of further planes
+    int hull_max_points;                  //!< maximum number of inliers used for a hull
+    bool scene_accumulation;              //!< publish the objects fused over the last frames
+    int accumulation_frames;              //!< accumulation window in frames
+    int accumulation_min_hits;            //!< frames of the window an objects voxel has to be observed in
+    int accumulation_max_voxels;          //!< size limit of the accumulation voxel map
+
+    Parameters();
+  };
+
 public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
   /**
    * @brief Construct a new PlaneSegmentation object
    * 
@@ -73,21 +163,110 @@ public:
    * @brief initalize the all ros subsribers/publishers, member variables
    * 
    * @param nh 
+   * @param transform_cache tf access shared with other nodes of the process,
+   * a new one is created if empty
    * @return true success
    * @return false failure
    */
-  bool initalize(ros::NodeHandle &nh);
+  bool initalize(ros::NodeHandle &nh, std::shared_ptr<TransformCache> transform_cache = nullptr);
+
+  /**
+   * @brief read the parameters from the rosparam server
+   * 
+   * @param params parameters, optional ones keep their value if not set
+   * @return true success
+   * @return false required parameter missing or invalid
+   */
+  static bool loadParameters(Parameters& params);
+
+  /**
+   * @brief apply the parameters to the processing, does not need a running
+   * ros master (initalize() calls it with the rosparams)
+   * 
+   * @param params parameters
+   * @return true success
+   * @return false invalid parameters
+   */
+  bool configure(const Parameters& params);
+
+  /**
+   * @brief block until a new pointcloud arrived (or timeout), the ros
+   * callbacks have to be served by another thread (e.g. ros::AsyncSpinner)
+   * 
+   * @param timeout maximum waiting time
+   * @return true new pointcloud available
+   * @return false timeout
+   */
+  bool waitForCloud(const ros::Duration &timeout);
 
   /**
-   * @brief called periodically, update the plane segmentation object
+   * @brief process the latest pointcloud, if a new one arrived
    * 
    * @param time current time
    */
   void update(const ros::Time &time);
 
+  /**
+   * @brief preprocess, segment and describe the planes of one cloud, without
+   * tf and publishing. This is the processing core of update(), usable
+   * offline after configure().
+   * 
+   * @param input sensor cloud
+   * @param T_base_sensor transformation from sensor frame into base frame
+   * @return true plane found
+   * @return false preprocessing failed or no plane found
+   */
+  bool process(const sensor_msgs::PointCloud2ConstPtr& input, const Eigen::Affine3f& T_base_sensor);
+
+  /**
+   * @brief first step of process(): voxel grid, base frame transform and
+   * pass filter, result in preprocessedCloud()
+   * 
+   * @param input sensor cloud
+   * @param T_base_sensor transformation from sensor frame into base frame
+   * @return true success
+   * @return false failure
+   */
+  bool preprocess(const sensor_msgs::PointCloud2ConstPtr& input, const Eigen::Affine3f& T_base_sensor);
+
+  /**
+   * @brief second step of process(): planes, plane cloud and objects cloud
+   * of the preprocessed cloud, the objects cloud is fused with the ones of
+   * the last frames if scene accumulation is enabled
+   * 
+   * @return true success
+   * @return false no plane found
+   */
+  bool segment();
+
+  /**
+   * @brief last step of process(): hulls, bounding rectangles and labeled
+   * points of the segmented planes, result in planes(), tablePolygon() and
+   * planeClouds()
+   * 
+   * @param hulls compute hulls and rectangles, else the planes only have
+   * coefficients and inlier counts and the table polygon stays empty
+   * @param plane_clouds collect the labeled points of all planes
+   */
+  void describePlanes(bool hulls = true, bool plane_clouds = true);
+
+  const PointCloud& preprocessedCloud() const { return *preprocessed_cloud_; }    //!< base frame, after preprocess()
+  const PointCloud& planeCloud() const { return *plane_cloud_; }                  //!< points of the table, after segment()
+  const PointCloud& objectsCloud() const { return *objects_cloud_; }              //!< points of the objects, after segment()
+  const PointCloud& accumulatedCloud() const { return *accumulated_cloud_; }      //!< objects of the last frames, after segment() with scene accumulation
+  const plane_segmentation::PlaneArray& planes() const { return planes_msg_; }    //!< all planes, after describePlanes()
+  const geometry_msgs::PolygonStamped& tablePolygon() const { return table_polygon_; }  //!< table rectangle, empty if not available
+  const pcl::PointCloud<pcl::PointXYZRGBL>& planeClouds() const { return plane_clouds_; }  //!< points of all planes, labeled by plane
+
+  LatencyMonitor& latencyMonitor() { return latency_monitor_; }   //!< per stage timing
+  const CloudPreprocessor& cloudPreprocessor() const { return cloud_preprocessor_; }  //!< point counts of the last preprocess()
+  uint64_t processingAllocations() const { return processing_allocations_; }  //!< allocations of the last preprocess() + segment()
+  uint64_t bufferGrowths() const { return buffer_growths_; }      //!< buffers that grew in the last segment()
+
 private:
   /**
-   * @brief apply preprocessing to input cloud and return output cloud
+   * @brief apply preprocessing to input cloud and return output cloud,
+   * with the sensor pose in T_base_sensor_
    * 
    * @param input inital cloud
    * @param output preprocessed cloud
@@ -96,6 +275,29 @@ private:
    */
   bool preProcessCloud(CloudPtr& input, CloudPtr& output);
 
+  /**
+   * @brief apply preprocessing directly to the serialized input message,
+   * voxelizes the raw buffer without a full resolution pcl copy, with the
+   * sensor pose in T_base_sensor_
+   * 
+   * @param input inital cloud message
+   * @param output preprocessed cloud
+   * @return true success
+   * @return false failure
+   */
+  bool preProcessCloud(const sensor_msgs::PointCloud2ConstPtr& input, CloudPtr& output);
+
+  /**
+   * @brief look up the sensor pose in base frame at the time of the cloud,
+   * the tf filter only hands on clouds whose transform is available
+   * 
+   * @param header header of the input cloud
+   * @param T_base_sensor transformation from sensor frame into base frame
+   * @return true success
+   * @return false transformation not available
+   */
+  bool lookupSensorTransform(const std_msgs::Header& header, Eigen::Affine3f& T_base_sensor);
+
   /**
    * @brief segment the input cloud into plane and objects (remaining)
    * 
@@ -108,37 +310,184 @@ private:
    */
   bool segmentCloud(CloudPtr& input, CloudPtr& plane_cloud, CloudPtr& objects_cloud);
 
+  /**
+   * @brief iteratively extract further planes from the points that are not
+   * on the primary plane. Works on index lists only, the remaining points are
+   * never copied. Fills plane_coefficients_, plane_inliers_ and remaining_indices_.
+   * 
+   * @param input preprocessed pointcloud (base frame)
+   * @param inliers indices of the primary plane
+   * @param coefficients coefficients of the primary plane
+   */
+  void extractPlanes(CloudPtr& input, const pcl::PointIndices& inliers, const pcl::ModelCoefficients& coefficients);
+
+  /**
+   * @brief describe and publish coefficients, hulls, bounding rectangles and
+   * a labeled cloud of all extracted planes and the rectangle of the primary
+   * plane. Only outputs with subscribers are computed and published.
+   * 
+   */
+  void publishPlanes();
+
+  /**
+   * @brief fit the table plane, tracks the plane of the previous frame if
+   * possible and falls back to a full segmentation otherwise
+   * 
+   * @param input preprocessed pointcloud (base frame)
+   * @param inliers indices of the plane points in input
+   * @param coefficients plane coefficients in base frame
+   * @return true success
+   * @return false no plane found
+   */
+  bool fitPlane(CloudPtr& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients);
+
+  /**
+   * @brief full segmentation of the table plane with the configured method,
+   * optionally runs the other method on the same frame to compare timings
+   * 
+   * @param input preprocessed pointcloud (base frame)
+   * @param inliers indices of the plane points in input
+   * @param coefficients plane coefficients in base frame
+   * @return true success
+   * @return false no plane found
+   */
+  bool detectPlane(CloudPtr& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients);
+
+  /**
+   * @brief publish the plane tracker state, heap usage and latencies on /diagnostics
+   * 
+   * @param time current time
+   */
+  void publishDiagnostics(const ros::Time& time);
+
+  /**
+   * @brief count the persistent buffers that had to grow in the last frame
+   * 
+   */
+  void updateBufferGrowths();
+
+  /**
+   * @brief fit the plane with RANSAC on the preprocessed cloud
+   * 
+   * @param input preprocessed pointcloud (base frame)
+   * @param inliers indices of the plane points in input
+   * @param coefficients plane coefficients in base frame
+   * @return true success
+   * @return false no plane found
+   */
+  bool fitPlaneRansac(CloudPtr& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients);
+
+  /**
+   * @brief fit a horizontal plane from the height histogram of the
+   * preprocessed cloud
+   * 
+   * @param input preprocessed pointcloud (base frame)
+   * @param inliers indices of the plane points in input
+   * @param coefficients plane coefficients in base frame
+   * @return true success
+   * @return false no horizontal plane found
+   */
+  bool fitPlaneHistogram(CloudPtr& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients);
+
+  /**
+   * @brief fit the plane on the organized sensor cloud (raw_cloud_), the
+   * largest (horizontal if required) plane is transformed into base frame and
+   * its inliers are selected from the preprocessed cloud by distance
+   * 
+   * @param input preprocessed pointcloud (base frame)
+   * @param inliers indices of the plane points in input
+   * @param coefficients plane coefficients in base frame
+   * @return true success
+   * @return false no plane found
+   */
+  bool fitPlaneOrganized(CloudPtr& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients);
+
 private:
   /**
-   * @brief callback function for new pointcloud subscriber
+   * @brief callback function for new pointcloud subscriber, called once the
+   * sensor pose at the stamp of the cloud is known
    * 
    * @param msg 
    */
   void cloudCallback(const sensor_msgs::PointCloud2ConstPtr &msg);
 
+  /**
+   * @brief callback of the tf filter for clouds without transform
+   * 
+   * @param msg 
+   * @param reason 
+   */
+  void cloudDroppedCallback(const sensor_msgs::PointCloud2ConstPtr &msg, tf2_ros::FilterFailureReason reason);
+
 private:
-  float pre_pass_low_, seg_pass_low_;                    // pass filter lower limit
-  float pre_pass_high_, seg_pass_high_;                    // pass filter upper limit
-  float ransac_thresh_;               // RANSAC outlier threshold
-  bool is_cloud_updated_;             //!< new pointcloud recived
+  Parameters params_;                 //!< processing configuration
   std::string base_frame_;            //!< robot base frame
   std::string pointcloud_topic_;      //!< pointcloud topic name
 
-  ros::Subscriber point_cloud_sub_;   //!< Subscribers to the PointCloud data
+  std::shared_ptr<TransformCache> transform_cache_;  //!< access ros tf tree to get frame transformations, outlives the tf filter
+  message_filters::Subscriber<sensor_msgs::PointCloud2> point_cloud_sub_;   //!< Subscribers to the PointCloud data
+  std::unique_ptr<tf2_ros::MessageFilter<sensor_msgs::PointCloud2> > tf_filter_; //!< holds clouds back until their transform is available
 
-  ros::Publisher plane_cloud_pub_;    //!< Publish table point cloud
-  ros::Publisher objects_cloud_pub_;  //!< Publish objects point cloud
-  ros::Publisher combined_cloud_pub_;
-  ros::Publisher plane_vertex_pub_;
+  ros::Publisher plane_cloud_pub_;    //!< Publish table point cloud (pcl, zero copy within a nodelet manager)
+  ros::Publisher objects_cloud_pub_;  //!< Publish objects point cloud (pcl, zero copy within a nodelet manager)
+  ros::Publisher combined_cloud_pub_; //!< Publish preprocessed point cloud (pcl, zero copy within a nodelet manager)
+  ros::Publisher table_polygon_pub_;  //!< Publish oriented rectangle of the table
+  ros::Publisher diagnostics_pub_;    //!< Publish plane tracker diagnostics
+  ros::Publisher planes_pub_;         //!< Publish coefficients and hulls of all planes
+  ros::Publisher plane_clouds_pub_;   //!< Publish points of all planes, labeled by plane
+  ros::Time last_diagnostics_time_;   //!< time of the last diagnostics message
 
-  // internal pointclouds
+  // latest pointcloud message, handed over from the callback thread
+  LatestFrameSlot<sensor_msgs::PointCloud2ConstPtr> cloud_slot_;
+
+  // internal pointclouds, the published ones come from the pool and are
+  // replaced before the next frame if a subscriber still holds them
   CloudPtr raw_cloud_;                  //!< Inital raw point cloud
   CloudPtr preprocessed_cloud_;         //!< after preprocessing
   CloudPtr plane_cloud_;                //!< points of table surface
   CloudPtr objects_cloud_;              //!< points of objects
+  CloudPtr accumulated_cloud_;          //!< stable points of objects over the last frames
+  SharedBufferPool<PointCloud> cloud_pool_; //!< published clouds
+
+  // planes, the slots only grow and keep their capacity between frames
+  size_t num_planes_;                                       //!< planes of the last frame, first slots below
+  std::vector<pcl::ModelCoefficients> plane_coefficients_;  //!< coefficients of all planes, primary first
+  std::vector<pcl::PointIndices> plane_inliers_;            //!< inliers of all planes, primary first
+  std::vector<uint8_t> plane_mask_;                         //!< per point: on a plane
+  pcl::IndicesPtr remaining_indices_;                       //!< points not on any plane, shared with the pcl RANSAC
+  pcl::PointIndices::Ptr inliers_;                          //!< inliers of the primary plane
+  pcl::ModelCoefficients::Ptr coefficients_;                //!< coefficients of the primary plane
+  pcl::SACSegmentation<PointT> sac_segmentation_;           //!< pcl RANSAC (parallel_ransac off), set up in configure()
+  pcl::PointIndices compare_inliers_;                       //!< inliers of the other method (compare_segmentation_methods)
+  pcl::ModelCoefficients compare_coefficients_;             //!< coefficients of the other method
+  pcl::PointCloud<pcl::PointXYZRGBL> plane_clouds_;         //!< points of all planes, labeled by plane
+  PlaneBoundingRectangle::Points3D plane_vertices_;         //!< hull or rectangle vertices of one plane
+  plane_segmentation::PlaneArray planes_msg_;               //!< descriptions of all planes
+  geometry_msgs::PolygonStamped table_polygon_;             //!< oriented rectangle of the primary plane
+
+  // heap usage, all per frame buffers above keep their capacity between frames
+  static const size_t kNumBuffers = 6;                      //!< number of persistent point buffers
+  std::array<size_t, kNumBuffers> buffer_capacities_;       //!< capacities after the last frame
+  uint64_t processed_frames_;         //!< number of processed clouds
+  uint64_t processing_allocations_;   //!< allocations of preprocessing + segmentation, last frame
+  uint64_t update_allocations_;       //!< allocations of the whole update, last frame
+  uint64_t buffer_growths_;           //!< buffers that grew in the last frame
+  uint64_t total_buffer_growths_;     //!< buffer growths since start
+  uint64_t preprocessor_reallocations_; //!< reallocations of the preprocessor at the last frame
+
+  CloudPreprocessor cloud_preprocessor_;  //!< fused workspace crop, voxel grid, base frame transform and pass filter
+  ParallelPlaneRansac plane_ransac_;  //!< multi threaded RANSAC plane fit
+  HorizontalPlaneDetector horizontal_detector_; //!< height histogram plane detection
+  OrganizedPlaneSegmenter organized_segmenter_; //!< plane segmentation on organized clouds
+  PlaneTracker plane_tracker_;        //!< tracks the plane over consecutive frames
+  PlaneBoundingRectangle bounding_rectangle_; //!< hull and minimum area rectangle of planes
+  SceneAccumulator scene_accumulator_;  //!< voxel map of the objects of the last frames
 
   // transformation
-  tf::TransformListener tfListener_;    //!< access ros tf tree to get frame transformations
+  Eigen::Affine3f T_base_sensor_;       //!< sensor pose of the current cloud
+
+  // instrumentation
+  LatencyMonitor latency_monitor_;      //!< per stage timing
 };
 
 #endif
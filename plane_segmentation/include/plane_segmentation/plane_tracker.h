@@ -0,0 +1,139 @@
+#ifndef PLANE_SEGMENTATION_PLANE_TRACKER_H
+#define PLANE_SEGMENTATION_PLANE_TRACKER_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+
+#include <Eigen/Core>
+
+#include <cstdint>
+
+/**
+ * @brief PlaneTracker, follows the table plane over consecutive frames.
+ * Seeds from the plane of the previous frame, counts its inliers in the new
+ * cloud and refines it with a least squares fit over these inliers. Tracking
+ * fails if the inlier ratio dropped below a fraction of the ratio observed
+ * at the last full fit, the caller then has to run a full segmentation and
+ * hand the result back with setPlane().
+ */
+class PlaneTracker
+{
+public:
+  // pcl pointcloud types
+  typedef pcl::PointXYZRGB PointT;                // The Point Type
+  typedef pcl::PointCloud<PointT> PointCloud;     // The PointCloud Type
+
+  /**
+   * @brief tracker states
+   *
+   */
+  enum State
+  {
+    NO_PLANE,     //!< no plane known, full segmentation needed
+    TRACKING,     //!< last frame was tracked
+    REFIT         //!< last frame needed a full segmentation
+  };
+
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /**
+   * @brief Construct a new PlaneTracker object
+   *
+   * @param distance_threshold maximum point to plane distance of the inliers
+   * @param min_inlier_ratio fraction of the reference inlier ratio required to keep tracking
+   */
+  PlaneTracker(float distance_threshold = 0.02f, float min_inlier_ratio = 0.8f);
+
+  /**
+   * @brief Destroy the PlaneTracker object
+   *
+   */
+  ~PlaneTracker();
+
+  /**
+   * @brief set the maximum point to plane distance of the inliers
+   *
+   * @param distance distance in meter
+   */
+  void setDistanceThreshold(float distance);
+
+  /**
+   * @brief set the fraction of the reference inlier ratio required to keep tracking
+   *
+   * @param ratio fraction in [0, 1]
+   */
+  void setMinInlierRatio(float ratio);
+
+  /**
+   * @brief forget the tracked plane
+   *
+   */
+  void reset();
+
+  /**
+   * @brief hand over the result of a full segmentation, becomes the new reference
+   *
+   * @param coefficients plane coefficients
+   * @param num_inliers number of plane inliers
+   * @param num_points number of points of the segmented cloud
+   */
+  void setPlane(const pcl::ModelCoefficients& coefficients, size_t num_inliers, size_t num_points);
+
+  /**
+   * @brief track the plane in a new cloud
+   *
+   * @param input new cloud, same frame as the tracked plane
+   * @param inliers indices of the plane points in input
+   * @param coefficients refined plane coefficients
+   * @return true plane tracked
+   * @return false no plane or inlier ratio too low, full segmentation needed
+   */
+  bool track(const PointCloud& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients);
+
+  /**
+   * @brief current state
+   *
+   */
+  State state() const { return state_; }
+
+  /**
+   * @brief name of the current state
+   *
+   */
+  const char* stateName() const;
+
+  /**
+   * @brief fraction of the frames that were tracked without full segmentation
+   *
+   */
+  double hitRate() const;
+
+  uint64_t trackedFrames() const { return tracked_frames_; }      //!< frames tracked
+  uint64_t fullFits() const { return full_fits_; }                //!< frames with full segmentation
+  float inlierRatio() const { return inlier_ratio_; }             //!< inlier ratio of the last frame
+  float referenceInlierRatio() const { return reference_ratio_; } //!< inlier ratio at the last full fit
+
+private:
+  /**
+   * @brief collect the points within the distance threshold of the plane
+   *
+   */
+  void selectInliers(const PointCloud& input, const Eigen::Vector4f& plane, pcl::PointIndices& inliers) const;
+
+private:
+  float distance_threshold_;          //!< maximum point to plane distance
+  float min_inlier_ratio_;            //!< required fraction of the reference ratio
+
+  State state_;                       //!< current state
+  Eigen::Vector4f plane_;             //!< tracked plane (a, b, c, d), unit normal
+  float reference_ratio_;             //!< inlier ratio of the last full fit
+  float inlier_ratio_;                //!< inlier ratio of the last frame
+
+  uint64_t tracked_frames_;           //!< number of tracked frames
+  uint64_t full_fits_;                //!< number of full segmentations
+};
+
+#endif
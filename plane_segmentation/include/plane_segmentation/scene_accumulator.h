@@ -0,0 +1,164 @@
+#ifndef PLANE_SEGMENTATION_SCENE_ACCUMULATOR_H
+#define PLANE_SEGMENTATION_SCENE_ACCUMULATOR_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief SceneAccumulator, fuses the objects clouds of the last frames into
+ * a voxel map in base frame. Every voxel remembers in which of the last N
+ * frames it was observed (one bit per frame), the hit count decays as
+ * frames pass without an observation and the voxel is dropped once it was
+ * not seen for N frames. Voxels observed in at least min_hits of the last N
+ * frames make up the accumulated cloud: sensor noise seen in a single frame
+ * is removed, objects that are briefly occluded stay.
+ *
+ * The map is bounded, at most max_voxels voxels are kept and points of new
+ * voxels are ignored while the map is full. The voxels are hashed into a
+ * flat open addressing table that is rebuilt once per frame after expired
+ * voxels were dropped, all buffers keep their capacity between frames.
+ *
+ * The base frame has to stay put over the accumulation window, e.g. the
+ * robot standing at the table. Call reset() when it moved.
+ */
+class SceneAccumulator
+{
+public:
+  // pcl pointcloud types
+  typedef pcl::PointXYZRGB PointT;                // The Point Type
+  typedef pcl::PointCloud<PointT> PointCloud;     // The PointCloud Type
+
+  static const int kMaxFrames = 64;               //!< longest accumulation window
+
+public:
+  /**
+   * @brief Construct a new SceneAccumulator object
+   *
+   * @param leaf_size edge length of the voxels in meter
+   * @param frames accumulation window in frames, 1 to kMaxFrames
+   * @param min_hits frames of the window a voxel has to be observed in
+   * @param max_voxels maximum number of voxels in the map
+   */
+  SceneAccumulator(float leaf_size = 0.01f, int frames = 5, int min_hits = 2, size_t max_voxels = 200000);
+
+  /**
+   * @brief Destroy the SceneAccumulator object
+   *
+   */
+  ~SceneAccumulator();
+
+  /**
+   * @brief set the edge length of the voxels, clears the map
+   *
+   * @param leaf_size edge length in meter
+   */
+  void setLeafSize(float leaf_size);
+
+  /**
+   * @brief set the accumulation window, clipped to 1 .. kMaxFrames
+   *
+   * @param frames number of frames
+   */
+  void setFrames(int frames);
+
+  /**
+   * @brief set the number of frames of the window a voxel has to be
+   * observed in to be part of the accumulated cloud
+   *
+   * @param min_hits number of frames, clipped to 1 .. frames
+   */
+  void setMinHits(int min_hits);
+
+  /**
+   * @brief set the maximum number of voxels, clears the map and releases the table
+   *
+   * @param max_voxels number of voxels
+   */
+  void setMaxVoxels(size_t max_voxels);
+
+  /**
+   * @brief forget all frames
+   *
+   */
+  void reset();
+
+  /**
+   * @brief add the next frame: ages all voxels by one frame, drops the
+   * expired ones and inserts the points of the cloud
+   *
+   * @param input objects cloud of the frame, in base frame
+   */
+  void add(const PointCloud& input);
+
+  /**
+   * @brief write the centroids of all stable voxels into output, the header
+   * is the one of the last added cloud
+   *
+   * @param output accumulated cloud
+   */
+  void extract(PointCloud& output) const;
+
+  size_t size() const { return voxels_.size(); }              //!< voxels in the map
+  uint64_t frames() const { return frame_count_; }            //!< frames added since the last reset
+  size_t droppedPoints() const { return dropped_points_; }    //!< points of the last frame ignored because the map was full
+
+private:
+  /**
+   * @brief one cell of the map
+   *
+   */
+  struct Voxel
+  {
+    int i, j, k;                      //!< grid index
+    float x, y, z;                    //!< mean of coordinates
+    float r, g, b;                    //!< mean of color channels
+    uint32_t count;                   //!< weight of the means, saturates
+    uint64_t hits;                    //!< bit n: observed n frames ago
+  };
+
+  /**
+   * @brief pack the grid index into a hash key, 21 bits per axis
+   *
+   */
+  static uint64_t voxelKey(int i, int j, int k);
+
+  /**
+   * @brief shift the hit masks by one frame, drop voxels without hits
+   * inside the window and rebuild the hash table
+   *
+   */
+  void age();
+
+  /**
+   * @brief index of the voxel in voxels_, inserts a new voxel if there is
+   * room, returns -1 if the map is full
+   *
+   */
+  int64_t findOrInsert(int i, int j, int k);
+
+  /**
+   * @brief allocate an empty table that fits max_voxels_ at half load
+   *
+   */
+  void allocateTable();
+
+private:
+  float leaf_size_;                                   //!< voxel edge length
+  float inv_leaf_size_;                               //!< 1 / leaf_size_
+  int frames_;                                        //!< accumulation window
+  int min_hits_;                                      //!< observations needed in the window
+  uint64_t window_mask_;                              //!< the lowest frames_ bits
+  size_t max_voxels_;                                 //!< map size limit
+  std::vector<uint64_t> keys_;                        //!< open addressing table: voxel key per slot
+  std::vector<uint32_t> slots_;                       //!< open addressing table: index in voxels_ per slot
+  size_t table_mask_;                                 //!< table size - 1, the size is a power of two
+  std::vector<Voxel> voxels_;                         //!< voxels of the map
+  pcl::PCLHeader header_;                             //!< header of the last added cloud
+  uint64_t frame_count_;                              //!< frames since the last reset
+  size_t dropped_points_;                             //!< points of the last frame without room in the map
+};
+
+#endif
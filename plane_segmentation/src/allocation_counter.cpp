@@ -0,0 +1,31 @@
+#include <plane_segmentation/allocation_counter.h>
+
+#include <atomic>
+
+namespace {
+
+thread_local uint64_t thread_allocations = 0;
+std::atomic<bool> hooks_installed(false);
+
+}  // namespace
+
+bool AllocationCounter::available()
+{
+  return hooks_installed.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::count()
+{
+  return thread_allocations;
+}
+
+void AllocationCounter::record()
+{
+  ++thread_allocations;
+}
+
+bool AllocationCounter::install()
+{
+  hooks_installed.store(true, std::memory_order_relaxed);
+  return true;
+}
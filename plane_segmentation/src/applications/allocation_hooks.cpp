@@ -0,0 +1,98 @@
+// Counting replacements of the global allocation functions for the
+// executables of this package (node and benchmark), see AllocationCounter.
+// Not part of the plane_segmentation library on purpose.
+#include <plane_segmentation/allocation_counter.h>
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+const bool installed = AllocationCounter::install();
+
+void* countedAllocation(std::size_t size)
+{
+  AllocationCounter::record();
+  if(size == 0)
+    size = 1;
+
+  while(true)
+  {
+    void* ptr = std::malloc(size);
+    if(ptr != nullptr)
+      return ptr;
+
+    std::new_handler handler = std::get_new_handler();
+    if(handler == nullptr)
+      throw std::bad_alloc();
+    handler();
+  }
+}
+
+}  // namespace
+
+// counting replacements of the global allocation functions
+
+void* operator new(std::size_t size)
+{
+  return countedAllocation(size);
+}
+
+void* operator new[](std::size_t size)
+{
+  return countedAllocation(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  try
+  {
+    return countedAllocation(size);
+  }
+  catch(...)
+  {
+    return nullptr;
+  }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  try
+  {
+    return countedAllocation(size);
+  }
+  catch(...)
+  {
+    return nullptr;
+  }
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+  std::free(ptr);
+}
@@ -0,0 +1,270 @@
+#include <plane_segmentation/plane_segmentation.h>
+
+#include <pcl/io/pcd_io.h>
+
+#include <dirent.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * Offline benchmark of the PlaneSegmentation processing core. Replays all
+ * pcd files of a directory without ros master, tf or publishers and reports
+ * the throughput, the per stage latencies and the peak memory usage.
+ *
+ * The clouds are expected in sensor frame. The sensor pose in base frame is
+ * taken from the viewpoint stored in the pcd files, or fixed with --transform.
+ */
+
+namespace {
+
+void printUsage()
+{
+  std::printf(
+    "usage: plane_segmentation_benchmark <pcd_directory> [options]\n"
+    "  --repeat N                      timed passes over the directory (default 10)\n"
+    "  --transform x y z roll pitch yaw  fixed sensor pose in base frame (m, rad),\n"
+    "                                  default is the viewpoint of the pcd files\n"
+    "  --workspace xmin ymin zmin xmax ymax zmax  workspace box in base frame (m)\n"
+    "  --leaf-size S                   voxel leaf size (default 0.01)\n"
+    "  --ransac-threshold D            plane inlier distance (default 0.02)\n"
+    "  --ransac-threads N              threads of the parallel RANSAC, 0 for one per core (default 0)\n"
+    "  --pcl-ransac                    pcl::SACSegmentation instead of the parallel RANSAC\n"
+    "  --method ransac|organized|height_histogram  plane segmentation method (default ransac)\n"
+    "  --horizontal ANGLE              only planes within ANGLE degrees of horizontal\n"
+    "  --max-planes N                  maximum number of planes (default 1)\n"
+    "  --no-tracking                   full plane segmentation on every frame\n"
+    "  --pcl-ingestion                 convert to pcl before voxelization\n");
+}
+
+/**
+ * @brief peak resident set size of the process in MB
+ */
+double peakRssMb()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;    // kB on linux
+}
+
+/**
+ * @brief load all pcd files of a directory, sorted by name
+ */
+bool loadClouds(const std::string& directory,
+                std::vector<sensor_msgs::PointCloud2ConstPtr>& clouds,
+                std::vector<Eigen::Affine3f, Eigen::aligned_allocator<Eigen::Affine3f> >& viewpoints)
+{
+  DIR* dir = opendir(directory.c_str());
+  if(!dir)
+  {
+    std::fprintf(stderr, "cannot open directory %s\n", directory.c_str());
+    return false;
+  }
+  std::vector<std::string> files;
+  while(dirent* entry = readdir(dir))
+  {
+    std::string name = entry->d_name;
+    if(name.size() > 4 && name.compare(name.size() - 4, 4, ".pcd") == 0)
+      files.push_back(directory + "/" + name);
+  }
+  closedir(dir);
+  std::sort(files.begin(), files.end());
+
+  for(const std::string& file : files)
+  {
+    pcl::PCLPointCloud2 cloud;
+    Eigen::Vector4f origin;
+    Eigen::Quaternionf orientation;
+    if(pcl::io::loadPCDFile(file, cloud, origin, orientation) < 0)
+    {
+      std::fprintf(stderr, "cannot read %s\n", file.c_str());
+      return false;
+    }
+
+    sensor_msgs::PointCloud2Ptr msg(new sensor_msgs::PointCloud2);
+    pcl_conversions::moveFromPCL(cloud, *msg);
+    msg->header.frame_id = "sensor";
+    clouds.push_back(msg);
+
+    Eigen::Affine3f T_base_sensor = Eigen::Affine3f::Identity();
+    T_base_sensor.linear() = orientation.normalized().toRotationMatrix();
+    T_base_sensor.translation() = origin.head<3>();
+    viewpoints.push_back(T_base_sensor);
+  }
+  return !clouds.empty();
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  if(argc < 2 || std::strcmp(argv[1], "--help") == 0)
+  {
+    printUsage();
+    return argc < 2 ? 1 : 0;
+  }
+
+  // ros time is used by the throttled log messages, without a master it is the wall time
+  ros::Time::init();
+
+  std::string directory = argv[1];
+  int repeat = 10;
+  bool fixed_transform = false;
+  Eigen::Affine3f T_fixed = Eigen::Affine3f::Identity();
+  PlaneSegmentation::Parameters params;
+
+  for(int i = 2; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if(arg == "--repeat" && has_value)
+      repeat = std::atoi(argv[++i]);
+    else if(arg == "--transform" && i + 6 < argc)
+    {
+      float v[6];
+      for(int j = 0; j < 6; ++j)
+        v[j] = std::atof(argv[++i]);
+      T_fixed = Eigen::Translation3f(v[0], v[1], v[2]) *
+                Eigen::AngleAxisf(v[5], Eigen::Vector3f::UnitZ()) *
+                Eigen::AngleAxisf(v[4], Eigen::Vector3f::UnitY()) *
+                Eigen::AngleAxisf(v[3], Eigen::Vector3f::UnitX());
+      fixed_transform = true;
+    }
+    else if(arg == "--workspace" && i + 6 < argc)
+    {
+      for(int j = 0; j < 3; ++j)
+        params.workspace_min[j] = std::atof(argv[++i]);
+      for(int j = 0; j < 3; ++j)
+        params.workspace_max[j] = std::atof(argv[++i]);
+    }
+    else if(arg == "--leaf-size" && has_value)
+      params.voxel_leaf_size = std::atof(argv[++i]);
+    else if(arg == "--ransac-threshold" && has_value)
+      params.ransac_threshold = std::atof(argv[++i]);
+    else if(arg == "--ransac-threads" && has_value)
+      params.ransac_threads = std::atoi(argv[++i]);
+    else if(arg == "--pcl-ransac")
+      params.parallel_ransac = false;
+    else if(arg == "--method" && has_value)
+    {
+      std::string method = argv[++i];
+      if(method == "ransac")
+        params.segmentation_method = PlaneSegmentation::RANSAC;
+      else if(method == "organized")
+        params.segmentation_method = PlaneSegmentation::ORGANIZED;
+      else if(method == "height_histogram")
+        params.segmentation_method = PlaneSegmentation::HEIGHT_HISTOGRAM;
+      else
+      {
+        printUsage();
+        return 1;
+      }
+    }
+    else if(arg == "--horizontal" && has_value)
+    {
+      params.horizontal_planes = true;
+      params.max_plane_angle = std::atof(argv[++i]);
+    }
+    else if(arg == "--max-planes" && has_value)
+      params.max_planes = std::atoi(argv[++i]);
+    else if(arg == "--no-tracking")
+      params.plane_tracking = false;
+    else if(arg == "--pcl-ingestion")
+      params.zero_copy_ingestion = false;
+    else
+    {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if(repeat < 1)
+  {
+    printUsage();
+    return 1;
+  }
+
+  std::vector<sensor_msgs::PointCloud2ConstPtr> clouds;
+  std::vector<Eigen::Affine3f, Eigen::aligned_allocator<Eigen::Affine3f> > viewpoints;
+  if(!loadClouds(directory, clouds, viewpoints))
+  {
+    std::fprintf(stderr, "no pcd files in %s\n", directory.c_str());
+    return 1;
+  }
+  double loaded_rss = peakRssMb();
+
+  PlaneSegmentation segmentation("", "base_footprint");
+  if(!segmentation.configure(params))
+    return 1;
+
+  // one untimed pass to grow the buffers and lock the plane tracker
+  for(size_t i = 0; i < clouds.size(); ++i)
+    segmentation.process(clouds[i], fixed_transform ? T_fixed : viewpoints[i]);
+  segmentation.latencyMonitor().reset();
+  size_t frame_stage = segmentation.latencyMonitor().addStage("frame");
+
+  size_t frames = 0, segmented = 0;
+  uint64_t allocations = 0, buffer_growths = 0;
+  uint64_t input_points = 0, accepted_points = 0;
+  std::vector<float> frame_times;
+  frame_times.reserve(repeat * clouds.size());
+
+  LatencyMonitor::Clock::time_point start = LatencyMonitor::Clock::now();
+  for(int pass = 0; pass < repeat; ++pass)
+  {
+    for(size_t i = 0; i < clouds.size(); ++i)
+    {
+      LatencyMonitor::Clock::time_point frame_start = LatencyMonitor::Clock::now();
+      if(segmentation.process(clouds[i], fixed_transform ? T_fixed : viewpoints[i]))
+        ++segmented;
+      std::chrono::duration<double> frame_time = LatencyMonitor::Clock::now() - frame_start;
+      segmentation.latencyMonitor().record(frame_stage, frame_time.count());
+      frame_times.push_back(frame_time.count());
+
+      allocations += segmentation.processingAllocations();
+      buffer_growths += segmentation.bufferGrowths();
+      input_points += segmentation.cloudPreprocessor().inputPoints();
+      accepted_points += segmentation.cloudPreprocessor().acceptedPoints();
+      ++frames;
+    }
+  }
+  std::chrono::duration<double> elapsed = LatencyMonitor::Clock::now() - start;
+
+  std::sort(frame_times.begin(), frame_times.end());
+  double mean = 0.0;
+  for(float t : frame_times)
+    mean += t;
+  mean /= frames;
+
+  std::printf("clouds:            %zu (%zu passes, %zu frames, %zu with plane)\n",
+    clouds.size(), static_cast<size_t>(repeat), frames, segmented);
+  std::printf("throughput:        %.1f frames/s\n", frames / elapsed.count());
+  std::printf("frame latency:     mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+    1e3 * mean, 1e3 * frame_times[frames / 2],
+    1e3 * frame_times[std::min(frames - 1, static_cast<size_t>(0.99 * frames))], 1e3 * frame_times.back());
+  std::printf("voxelized points:  %.1f%% of %.0f per frame (workspace and z limits)\n",
+    input_points ? 100.0 * accepted_points / input_points : 0.0, static_cast<double>(input_points) / frames);
+  if(AllocationCounter::available())
+    std::printf("allocations:       %.1f per frame (preprocessing + segmentation)\n",
+      static_cast<double>(allocations) / frames);
+  else
+    std::printf("allocations:       unavailable (allocation_hooks.cpp not linked)\n");
+  std::printf("buffer growths:    %llu after warm-up\n", static_cast<unsigned long long>(buffer_growths));
+  std::printf("peak rss:          %.1f MB (%.1f MB after loading the clouds)\n", peakRssMb(), loaded_rss);
+
+  diagnostic_msgs::DiagnosticStatus status;
+  segmentation.latencyMonitor().getStatus(status);
+  std::printf("stages, %s:\n", status.message.c_str());
+  for(const diagnostic_msgs::KeyValue& value : status.values)
+  {
+    // stages of the ros wrapper (tf, publishing) are not part of the benchmark
+    if(value.key.size() > 6 && value.key.compare(value.key.size() - 6, 6, " count") == 0 && value.value == "0")
+      continue;
+    std::printf("  %-28s %s\n", value.key.c_str(), value.value.c_str());
+  }
+  return 0;
+}
@@ -24,14 +24,15 @@ int main(int argc, char** argv)
     return -1;
   }
 
-  // update the processing
-  ros::Rate rate(30);
+  // serve the callbacks in the background, process as soon as a cloud arrives
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
   while(ros::ok())
   {
-    segmentation.update(ros::Time::now());
-    ros::spinOnce();
-    rate.sleep();
+    if(segmentation.waitForCloud(ros::Duration(0.1)))
+      segmentation.update(ros::Time::now());
   }
+  spinner.stop();
 
   return 0;
 }
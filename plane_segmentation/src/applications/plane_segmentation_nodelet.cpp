@@ -0,0 +1,71 @@
+#include <plane_segmentation/plane_segmentation.h>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <atomic>
+#include <thread>
+
+/**
+ * @brief PlaneSegmentationNodelet, runs PlaneSegmentation inside a nodelet
+ * manager. The published clouds are handed to other nodelets of the manager
+ * (e.g. ObjectLabelingNodelet) as shared pointers without serialization.
+ *
+ * Like plane_segmentation_node the processing runs in its own thread, the
+ * manager threads only serve the callbacks.
+ *
+ * Private parameters: pointcloud_topic, base_frame
+ */
+class PlaneSegmentationNodelet : public nodelet::Nodelet
+{
+public:
+  PlaneSegmentationNodelet() :
+    running_(false)
+  {
+  }
+
+  ~PlaneSegmentationNodelet()
+  {
+    running_ = false;
+    if(worker_.joinable())
+      worker_.join();
+  }
+
+private:
+  void onInit() override
+  {
+    ros::NodeHandle& nh = getNodeHandle();
+    ros::NodeHandle& pnh = getPrivateNodeHandle();
+
+    std::string pointcloud_topic, base_frame;
+    pnh.param<std::string>("pointcloud_topic", pointcloud_topic, "/hsrb/head_rgbd_sensor/depth_registered/rectified_points");
+    pnh.param<std::string>("base_frame", base_frame, "base_footprint");
+
+    // one tf buffer for all nodelets of the manager
+    segmentation_.reset(new PlaneSegmentation(pointcloud_topic, base_frame));
+    if(!segmentation_->initalize(nh, TransformCache::instance(nh)))
+    {
+      NODELET_ERROR_STREAM("Error init PlaneSegmentation");
+      return;
+    }
+
+    running_ = true;
+    worker_ = std::thread(&PlaneSegmentationNodelet::run, this);
+  }
+
+  void run()
+  {
+    while(running_ && ros::ok())
+    {
+      if(segmentation_->waitForCloud(ros::Duration(0.1)))
+        segmentation_->update(ros::Time::now());
+    }
+  }
+
+private:
+  std::unique_ptr<PlaneSegmentation> segmentation_;   //!< processing, created in onInit()
+  std::atomic<bool> running_;                         //!< worker keeps processing
+  std::thread worker_;                                //!< processing thread
+};
+
+PLUGINLIB_EXPORT_CLASS(PlaneSegmentationNodelet, nodelet::Nodelet)
@@ -0,0 +1,299 @@
+#include <plane_segmentation/cloud_preprocessor.h>
+
+#include <ros/console.h>
+#include <pcl_conversions/pcl_conversions.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const uint64_t kEmptyKey = std::numeric_limits<uint64_t>::max();   // never a valid 63 bit key
+const size_t kMinTableSize = 1 << 12;
+
+}  // namespace
+
+CloudPreprocessor::CloudPreprocessor(float leaf_size) :
+  pass_low_(-std::numeric_limits<float>::max()),
+  pass_high_(std::numeric_limits<float>::max()),
+  workspace_min_(Eigen::Vector3f::Constant(-std::numeric_limits<float>::max())),
+  workspace_max_(Eigen::Vector3f::Constant(std::numeric_limits<float>::max())),
+  T_base_sensor_(Eigen::Affine3f::Identity()),
+  keys_(kMinTableSize, kEmptyKey),
+  slots_(kMinTableSize, 0),
+  table_mask_(kMinTableSize - 1),
+  reallocations_(0),
+  input_points_(0),
+  accepted_points_(0)
+{
+  setLeafSize(leaf_size);
+}
+
+CloudPreprocessor::~CloudPreprocessor()
+{
+}
+
+void CloudPreprocessor::setLeafSize(float leaf_size)
+{
+  leaf_size_ = leaf_size;
+  inv_leaf_size_ = 1.0f / leaf_size;
+  updateBounds();
+}
+
+void CloudPreprocessor::setFilterLimits(float low, float high)
+{
+  pass_low_ = low;
+  pass_high_ = high;
+  updateBounds();
+}
+
+void CloudPreprocessor::setWorkspace(const Eigen::Vector3f& min, const Eigen::Vector3f& max)
+{
+  workspace_min_ = min;
+  workspace_max_ = max;
+  updateBounds();
+}
+
+void CloudPreprocessor::setTransform(const Eigen::Affine3f& T_base_sensor)
+{
+  T_base_sensor_ = T_base_sensor;
+}
+
+bool CloudPreprocessor::process(const sensor_msgs::PointCloud2& input, PointCloud& output)
+{
+  int x_offset = fieldOffset(input, "x");
+  int y_offset = fieldOffset(input, "y");
+  int z_offset = fieldOffset(input, "z");
+  int rgb_offset = fieldOffset(input, "rgb");
+  if(rgb_offset < 0)
+    rgb_offset = fieldOffset(input, "rgba");
+
+  if(x_offset < 0 || y_offset < 0 || z_offset < 0)
+  {
+    ROS_ERROR_STREAM("CloudPreprocessor: input cloud has no float32 x, y, z fields");
+    return false;
+  }
+
+  // the buffer is read without further checks, so every row has to be in it
+  // and every field within a point
+  size_t max_offset = std::max({x_offset, y_offset, z_offset, rgb_offset}) + sizeof(float);
+  if(input.data.size() < static_cast<size_t>(input.height) * input.row_step ||
+     static_cast<size_t>(input.width) * input.point_step > input.row_step ||
+     max_offset > input.point_step)
+  {
+    ROS_ERROR_STREAM("CloudPreprocessor: malformed input cloud, " << input.data.size() << " bytes for "
+      << input.height << " rows of " << input.row_step << " bytes, " << input.width << " points of "
+      << input.point_step << " bytes per row, fields up to byte " << max_offset);
+    return false;
+  }
+
+  reset();
+
+  // walk over the raw buffer, rows might be padded so use row_step
+  float x, y, z;
+  uint32_t rgb = 0;
+  for(uint32_t v = 0; v < input.height; ++v)
+  {
+    const uint8_t* pt = &input.data[v * input.row_step];
+    for(uint32_t u = 0; u < input.width; ++u, pt += input.point_step)
+    {
+      std::memcpy(&x, pt + x_offset, sizeof(float));
+      std::memcpy(&y, pt + y_offset, sizeof(float));
+      std::memcpy(&z, pt + z_offset, sizeof(float));
+      if(!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(z))
+        continue;
+      if(rgb_offset >= 0)
+        std::memcpy(&rgb, pt + rgb_offset, sizeof(uint32_t));
+
+      accumulate(x, y, z, rgb);
+    }
+  }
+
+  extract(output);
+  pcl_conversions::toPCL(input.header, output.header);
+  return true;
+}
+
+bool CloudPreprocessor::process(const PointCloud& input, PointCloud& output)
+{
+  reset();
+
+  for(const PointT& pt : input.points)
+  {
+    if(!std::isfinite(pt.x) || !std::isfinite(pt.y) || !std::isfinite(pt.z))
+      continue;
+    accumulate(pt.x, pt.y, pt.z, pt.rgba);
+  }
+
+  // copy the header first, output may alias input
+  pcl::PCLHeader header = input.header;
+  extract(output);
+  output.header = header;
+  return true;
+}
+
+void CloudPreprocessor::updateBounds()
+{
+  box_min_ = workspace_min_;
+  box_max_ = workspace_max_;
+  box_min_.z() = std::max(box_min_.z(), pass_low_);
+  box_max_.z() = std::min(box_max_.z(), pass_high_);
+
+  // all points of a voxel are within one voxel diagonal of each other, a point
+  // further than that outside the box has a voxel centroid outside as well.
+  // The margin is slightly enlarged to stay conservative under float rounding.
+  float margin = 1.01f * std::sqrt(3.0f) * leaf_size_;
+  for(int axis = 0; axis < 3; ++axis)
+  {
+    reject_min_[axis] = std::max(box_min_[axis], -std::numeric_limits<float>::max() + margin) - margin;
+    reject_max_[axis] = std::min(box_max_[axis], std::numeric_limits<float>::max() - margin) + margin;
+  }
+}
+
+uint64_t CloudPreprocessor::reallocations() const
+{
+  return reallocations_;
+}
+
+int CloudPreprocessor::fieldOffset(const sensor_msgs::PointCloud2& input, const std::string& name)
+{
+  for(const auto& field : input.fields)
+  {
+    if(field.name != name)
+      continue;
+    if(field.datatype != sensor_msgs::PointField::FLOAT32 &&
+       !(name.compare(0, 3, "rgb") == 0 && field.datatype == sensor_msgs::PointField::UINT32))
+      return -1;
+    return static_cast<int>(field.offset);
+  }
+  return -1;
+}
+
+void CloudPreprocessor::reset()
+{
+  std::fill(keys_.begin(), keys_.end(), kEmptyKey);
+  voxels_.clear();
+  input_points_ = 0;
+  accepted_points_ = 0;
+}
+
+uint64_t CloudPreprocessor::voxelKey(int i, int j, int k)
+{
+  // 21 bits per axis, enough for +-10km at 1cm leaf size
+  return (static_cast<uint64_t>(i & 0x1FFFFF) << 42) |
+         (static_cast<uint64_t>(j & 0x1FFFFF) << 21) |
+          static_cast<uint64_t>(k & 0x1FFFFF);
+}
+
+uint32_t CloudPreprocessor::findOrInsert(uint64_t key, int i, int j, int k)
+{
+  // keep the load factor below 1/2
+  if(2 * (voxels_.size() + 1) > keys_.size())
+    grow();
+
+  // fibonacci hashing, linear probing
+  size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & table_mask_;
+  while(keys_[slot] != kEmptyKey)
+  {
+    if(keys_[slot] == key)
+      return slots_[slot];
+    slot = (slot + 1) & table_mask_;
+  }
+
+  if(voxels_.size() == voxels_.capacity())
+    ++reallocations_;
+
+  keys_[slot] = key;
+  slots_[slot] = static_cast<uint32_t>(voxels_.size());
+  voxels_.push_back(Voxel{i, j, k, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0});
+  return slots_[slot];
+}
+
+void CloudPreprocessor::grow()
+{
+  ++reallocations_;
+  size_t size = 2 * keys_.size();
+  keys_.assign(size, kEmptyKey);
+  slots_.assign(size, 0);
+  table_mask_ = size - 1;
+
+  for(size_t idx = 0; idx < voxels_.size(); ++idx)
+  {
+    uint64_t key = voxelKey(voxels_[idx].i, voxels_[idx].j, voxels_[idx].k);
+    size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & table_mask_;
+    while(keys_[slot] != kEmptyKey)
+      slot = (slot + 1) & table_mask_;
+    keys_[slot] = key;
+    slots_[slot] = static_cast<uint32_t>(idx);
+  }
+}
+
+void CloudPreprocessor::accumulate(float x, float y, float z, uint32_t rgb)
+{
+  // early rejection in base frame, before any hashing
+  ++input_points_;
+  const Eigen::Matrix4f& T = T_base_sensor_.matrix();
+  float z_base = T(2, 0) * x + T(2, 1) * y + T(2, 2) * z + T(2, 3);
+  if(z_base < reject_min_.z() || z_base > reject_max_.z())
+    return;
+  float x_base = T(0, 0) * x + T(0, 1) * y + T(0, 2) * z + T(0, 3);
+  float y_base = T(1, 0) * x + T(1, 1) * y + T(1, 2) * z + T(1, 3);
+  if(x_base < reject_min_.x() || x_base > reject_max_.x() ||
+     y_base < reject_min_.y() || y_base > reject_max_.y())
+    return;
+  ++accepted_points_;
+
+  int i = static_cast<int>(std::floor(x * inv_leaf_size_));
+  int j = static_cast<int>(std::floor(y * inv_leaf_size_));
+  int k = static_cast<int>(std::floor(z * inv_leaf_size_));
+
+  Voxel& voxel = voxels_[findOrInsert(voxelKey(i, j, k), i, j, k)];
+  voxel.x += x;
+  voxel.y += y;
+  voxel.z += z;
+  voxel.r += static_cast<float>((rgb >> 16) & 0xFF);
+  voxel.g += static_cast<float>((rgb >> 8) & 0xFF);
+  voxel.b += static_cast<float>(rgb & 0xFF);
+  ++voxel.count;
+}
+
+void CloudPreprocessor::extract(PointCloud& output)
+{
+  // same ordering as the linear voxel index of pcl::VoxelGrid
+  std::sort(voxels_.begin(), voxels_.end(), [](const Voxel& a, const Voxel& b) {
+    if(a.k != b.k) return a.k < b.k;
+    if(a.j != b.j) return a.j < b.j;
+    return a.i < b.i;
+  });
+
+  output.points.clear();
+  if(output.points.capacity() < voxels_.size())
+  {
+    ++reallocations_;
+    output.points.reserve(voxels_.size());
+  }
+  PointT pt;
+  for(const Voxel& voxel : voxels_)
+  {
+    float count = static_cast<float>(voxel.count);
+    Eigen::Vector3f centroid(voxel.x / count, voxel.y / count, voxel.z / count);
+
+    // transform the centroid into base frame and apply pass filter and workspace
+    pt.getVector3fMap() = T_base_sensor_ * centroid;
+    if(pt.x < box_min_.x() || pt.x > box_max_.x() ||
+       pt.y < box_min_.y() || pt.y > box_max_.y() ||
+       pt.z < box_min_.z() || pt.z > box_max_.z())
+      continue;
+
+    // pcl::VoxelGrid packs the averaged channels with truncation and alpha 0
+    pt.rgba = (static_cast<uint32_t>(voxel.r / count) << 16) |
+              (static_cast<uint32_t>(voxel.g / count) << 8) |
+               static_cast<uint32_t>(voxel.b / count);
+    output.points.push_back(pt);
+  }
+  output.width = static_cast<uint32_t>(output.points.size());
+  output.height = 1;
+  output.is_dense = true;
+}
@@ -0,0 +1,141 @@
+#include <plane_segmentation/horizontal_plane_detector.h>
+
+#include <pcl/common/centroid.h>
+#include <pcl/common/eigen.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int kMaxBins = 1 << 14;       // caps the histogram for clouds with far outliers
+const int kMaxCandidates = 3;       // densest heights tried before giving up
+const int kRefinements = 3;         // least squares iterations per candidate
+
+}  // namespace
+
+HorizontalPlaneDetector::HorizontalPlaneDetector(float distance_threshold, float max_angle) :
+  distance_threshold_(distance_threshold),
+  indices_(nullptr)
+{
+  setMaxAngle(max_angle);
+}
+
+HorizontalPlaneDetector::~HorizontalPlaneDetector()
+{
+}
+
+void HorizontalPlaneDetector::setDistanceThreshold(float distance)
+{
+  distance_threshold_ = distance;
+}
+
+void HorizontalPlaneDetector::setMaxAngle(float angle)
+{
+  min_normal_z_ = std::cos(angle);
+}
+
+bool HorizontalPlaneDetector::detect(const PointCloud& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients)
+{
+  heights_.resize(input.points.size());
+  for(size_t i = 0; i < input.points.size(); ++i)
+    heights_[i] = input.points[i].z;
+  indices_ = nullptr;
+  return fit(input, inliers, coefficients);
+}
+
+bool HorizontalPlaneDetector::detect(const PointCloud& input, const std::vector<int>& indices,
+                                     pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients)
+{
+  heights_.resize(indices.size());
+  for(size_t i = 0; i < indices.size(); ++i)
+    heights_[i] = input.points[indices[i]].z;
+  indices_ = &indices;
+  return fit(input, inliers, coefficients);
+}
+
+bool HorizontalPlaneDetector::fit(const PointCloud& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients)
+{
+  inliers.indices.clear();
+  inliers.header = input.header;
+  coefficients.values.clear();
+  coefficients.header = input.header;
+  if(heights_.size() < 3 || !(distance_threshold_ > 0.0f))
+    return false;
+
+  // height histogram with the inlier distance as bin size
+  auto range = std::minmax_element(heights_.begin(), heights_.end());
+  float min_z = *range.first;
+  float bin_size = distance_threshold_;
+  if((*range.second - min_z) / bin_size >= kMaxBins - 1)
+    bin_size = (*range.second - min_z) / (kMaxBins - 1);
+  int num_bins = static_cast<int>((*range.second - min_z) / bin_size) + 1;
+
+  counts_.assign(num_bins, 0);
+  for(float z : heights_)
+    ++counts_[std::min(static_cast<int>((z - min_z) / bin_size), num_bins - 1)];
+
+  for(int candidate = 0; candidate < kMaxCandidates; ++candidate)
+  {
+    // densest window of three bins, tolerates noise and bin borders
+    int best_bin = -1, best_count = 0;
+    for(int i = 0; i < num_bins; ++i)
+    {
+      int count = counts_[i] + (i > 0 ? counts_[i - 1] : 0) + (i + 1 < num_bins ? counts_[i + 1] : 0);
+      if(count > best_count)
+      {
+        best_count = count;
+        best_bin = i;
+      }
+    }
+    if(best_count < 3)
+      return false;
+
+    // start from a level plane at the peak and let least squares find the tilt
+    Eigen::Vector4f plane(0.0f, 0.0f, 1.0f, -(min_z + (best_bin + 0.5f) * bin_size));
+    selectInliers(input, plane, inliers);
+    for(int refinement = 0; refinement < kRefinements && inliers.indices.size() >= 3; ++refinement)
+    {
+      Eigen::Matrix3f covariance;
+      Eigen::Vector4f centroid;
+      if(pcl::computeMeanAndCovarianceMatrix(input, inliers.indices, covariance, centroid) < 3)
+        break;
+
+      EIGEN_ALIGN16 float eigen_value;
+      Eigen::Vector3f normal;
+      pcl::eigen33(covariance, eigen_value, normal);
+      if(!std::isfinite(normal.norm()))
+        break;
+      if(normal.z() < 0.0f)
+        normal = -normal;
+      plane << normal, -normal.dot(centroid.head<3>());
+      selectInliers(input, plane, inliers);
+    }
+
+    if(plane[2] >= min_normal_z_ && inliers.indices.size() >= 3)
+    {
+      coefficients.values = {plane[0], plane[1], plane[2], plane[3]};
+      return true;
+    }
+
+    // too steep (e.g. a wall through a dense height band), try the next height
+    for(int i = std::max(best_bin - 1, 0); i <= std::min(best_bin + 1, num_bins - 1); ++i)
+      counts_[i] = 0;
+  }
+
+  inliers.indices.clear();
+  return false;
+}
+
+void HorizontalPlaneDetector::selectInliers(const PointCloud& input, const Eigen::Vector4f& plane, pcl::PointIndices& inliers) const
+{
+  inliers.indices.clear();
+  size_t n = heights_.size();
+  for(size_t i = 0; i < n; ++i)
+  {
+    int idx = indices_ ? (*indices_)[i] : static_cast<int>(i);
+    const PointT& pt = input.points[idx];
+    if(std::abs(plane[0] * pt.x + plane[1] * pt.y + plane[2] * pt.z + plane[3]) <= distance_threshold_)
+      inliers.indices.push_back(idx);
+  }
+}
@@ -0,0 +1,80 @@
+#include <plane_segmentation/organized_plane_segmenter.h>
+
+#include <algorithm>
+#include <numeric>
+
+OrganizedPlaneSegmenter::OrganizedPlaneSegmenter() :
+  normals_(new pcl::PointCloud<pcl::Normal>)
+{
+  normal_estimation_.setNormalEstimationMethod(normal_estimation_.COVARIANCE_MATRIX);
+  normal_estimation_.setBorderPolicy(normal_estimation_.BORDER_POLICY_IGNORE);
+  setNormalEstimation(0.02f, 10.0f);
+
+  setMinInliers(1000);
+  setAngularThreshold(0.035);     // ~2 deg
+  setDistanceThreshold(0.02);
+}
+
+OrganizedPlaneSegmenter::~OrganizedPlaneSegmenter()
+{
+}
+
+void OrganizedPlaneSegmenter::setMinInliers(unsigned int min_inliers)
+{
+  segmentation_.setMinInliers(min_inliers);
+}
+
+void OrganizedPlaneSegmenter::setAngularThreshold(double angle)
+{
+  segmentation_.setAngularThreshold(angle);
+}
+
+void OrganizedPlaneSegmenter::setDistanceThreshold(double distance)
+{
+  segmentation_.setDistanceThreshold(distance);
+}
+
+void OrganizedPlaneSegmenter::setNormalEstimation(float max_depth_change_factor, float smoothing_size)
+{
+  normal_estimation_.setMaxDepthChangeFactor(max_depth_change_factor);
+  normal_estimation_.setNormalSmoothingSize(smoothing_size);
+}
+
+bool OrganizedPlaneSegmenter::segment(const CloudPtr& input,
+                                      std::vector<pcl::ModelCoefficients>& coefficients,
+                                      std::vector<pcl::PointIndices>& inliers)
+{
+  coefficients.clear();
+  inliers.clear();
+  if(!input->isOrganized())
+    return false;
+
+  // normals from integral images, O(n) independent of the smoothing size
+  normal_estimation_.setInputCloud(input);
+  normal_estimation_.compute(*normals_);
+
+  // grow planar regions over the image grid
+  std::vector<pcl::ModelCoefficients> region_coefficients;
+  std::vector<pcl::PointIndices> region_inliers;
+  segmentation_.setInputCloud(input);
+  segmentation_.setInputNormals(normals_);
+  segmentation_.segment(region_coefficients, region_inliers);
+  if(region_coefficients.empty())
+    return false;
+
+  // largest plane first
+  std::vector<size_t> order(region_coefficients.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&region_inliers](size_t a, size_t b) {
+    return region_inliers[a].indices.size() > region_inliers[b].indices.size();
+  });
+
+  coefficients.reserve(order.size());
+  inliers.reserve(order.size());
+  for(size_t idx : order)
+  {
+    coefficients.push_back(region_coefficients[idx]);
+    inliers.push_back(region_inliers[idx]);
+  }
+  return true;
+}
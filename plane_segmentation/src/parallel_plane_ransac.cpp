@@ -0,0 +1,284 @@
+#include <plane_segmentation/parallel_plane_ransac.h>
+
+#include <pcl/common/centroid.h>
+#include <pcl/common/eigen.h>
+
+#include <algorithm>
+#include <cmath>
+
+ParallelPlaneRansac::ParallelPlaneRansac(unsigned int num_threads) :
+  num_threads_(1),
+  distance_threshold_(0.02f),
+  axis_(Eigen::Vector3f::UnitZ()),
+  eps_angle_(0.0f),
+  max_iterations_(1000),
+  probability_(0.99),
+  batch_size_(64),
+  iterations_(0),
+  indices_(nullptr),
+  next_hypothesis_(0),
+  batch_hypotheses_(0),
+  rng_(42),
+  batch_id_(0),
+  busy_workers_(0),
+  stop_(false)
+{
+  setNumThreads(num_threads);
+}
+
+ParallelPlaneRansac::~ParallelPlaneRansac()
+{
+  stopWorkers();
+}
+
+void ParallelPlaneRansac::setNumThreads(unsigned int num_threads)
+{
+  if(num_threads == 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  stopWorkers();
+  num_threads_ = num_threads;
+  startWorkers();
+}
+
+void ParallelPlaneRansac::setDistanceThreshold(float distance)
+{
+  distance_threshold_ = distance;
+}
+
+void ParallelPlaneRansac::setAxis(const Eigen::Vector3f& axis)
+{
+  axis_ = axis.normalized();
+}
+
+void ParallelPlaneRansac::setEpsAngle(float angle)
+{
+  eps_angle_ = angle;
+}
+
+void ParallelPlaneRansac::setMaxIterations(int max_iterations)
+{
+  max_iterations_ = std::max(1, max_iterations);
+}
+
+void ParallelPlaneRansac::setProbability(double probability)
+{
+  probability_ = std::min(std::max(probability, 1e-6), 1.0 - 1e-6);
+}
+
+void ParallelPlaneRansac::setBatchSize(int batch_size)
+{
+  batch_size_ = std::max(1, batch_size);
+}
+
+bool ParallelPlaneRansac::segment(const PointCloud& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients)
+{
+  size_t n = input.points.size();
+  x_.resize(n);
+  y_.resize(n);
+  z_.resize(n);
+  for(size_t i = 0; i < n; ++i)
+  {
+    x_[i] = input.points[i].x;
+    y_[i] = input.points[i].y;
+    z_[i] = input.points[i].z;
+  }
+  indices_ = nullptr;
+  return fit(input, inliers, coefficients);
+}
+
+bool ParallelPlaneRansac::segment(const PointCloud& input, const std::vector<int>& indices,
+                                  pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients)
+{
+  size_t n = indices.size();
+  x_.resize(n);
+  y_.resize(n);
+  z_.resize(n);
+  for(size_t i = 0; i < n; ++i)
+  {
+    const PointT& pt = input.points[indices[i]];
+    x_[i] = pt.x;
+    y_[i] = pt.y;
+    z_[i] = pt.z;
+  }
+  indices_ = &indices;
+  return fit(input, inliers, coefficients);
+}
+
+bool ParallelPlaneRansac::fit(const PointCloud& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients)
+{
+  inliers.indices.clear();
+  inliers.header = input.header;
+  coefficients.values.clear();
+  coefficients.header = input.header;
+  iterations_ = 0;
+
+  int n = static_cast<int>(x_.size());
+  if(n < 3)
+    return false;
+
+  hypotheses_.resize(batch_size_);
+  scores_.resize(batch_size_);
+  std::uniform_int_distribution<int> sample(0, n - 1);
+
+  Eigen::Vector4f best_plane = Eigen::Vector4f::Zero();
+  int best_score = 0;
+  double bound = max_iterations_;
+  while(iterations_ < std::min<double>(bound, max_iterations_))
+  {
+    // sample a batch of hypotheses, degenerate samples keep a zero normal
+    batch_hypotheses_ = std::min(batch_size_, max_iterations_ - iterations_);
+    for(int h = 0; h < batch_hypotheses_; ++h)
+    {
+      int i0 = sample(rng_), i1 = sample(rng_), i2 = sample(rng_);
+      Eigen::Vector3f p0(x_[i0], y_[i0], z_[i0]);
+      Eigen::Vector3f normal = (Eigen::Vector3f(x_[i1], y_[i1], z_[i1]) - p0).cross(
+                                Eigen::Vector3f(x_[i2], y_[i2], z_[i2]) - p0);
+      float norm = normal.norm();
+      if(i0 == i1 || i0 == i2 || i1 == i2 || !(norm > 1e-12f) || !isValid(normal / norm))
+      {
+        hypotheses_[h].setZero();
+        continue;
+      }
+      normal /= norm;
+      hypotheses_[h] << normal, -normal.dot(p0);
+    }
+
+    // score in parallel, the calling thread takes part
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      next_hypothesis_ = 0;
+      busy_workers_ = static_cast<unsigned int>(workers_.size());
+      ++batch_id_;
+    }
+    batch_cv_.notify_all();
+    scoreBatch();
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_cv_.wait(lock, [this] { return busy_workers_ == 0; });
+    }
+
+    for(int h = 0; h < batch_hypotheses_; ++h)
+    {
+      if(scores_[h] > best_score)
+      {
+        best_score = scores_[h];
+        best_plane = hypotheses_[h];
+      }
+    }
+    iterations_ += batch_hypotheses_;
+
+    // adaptive bound: samples needed to draw three inliers with probability_
+    if(best_score > 0)
+    {
+      double w = static_cast<double>(best_score) / n;
+      double p_outlier_sample = 1.0 - w * w * w;
+      if(p_outlier_sample <= 0.0)
+        break;
+      bound = std::log(1.0 - probability_) / std::log(p_outlier_sample);
+    }
+  }
+
+  if(best_score < 3)
+    return false;
+
+  // least squares refinement over the inliers, smallest eigenvector of the covariance
+  selectInliers(best_plane, inliers);
+  Eigen::Matrix3f covariance;
+  Eigen::Vector4f centroid;
+  if(pcl::computeMeanAndCovarianceMatrix(input, inliers.indices, covariance, centroid) > 3)
+  {
+    EIGEN_ALIGN16 float eigen_value;
+    Eigen::Vector3f normal;
+    pcl::eigen33(covariance, eigen_value, normal);
+    if(std::isfinite(normal.norm()) && isValid(normal))
+    {
+      if(normal.dot(best_plane.head<3>()) < 0.0f)
+        normal = -normal;
+      best_plane << normal, -normal.dot(centroid.head<3>());
+      selectInliers(best_plane, inliers);
+    }
+  }
+
+  coefficients.values = {best_plane[0], best_plane[1], best_plane[2], best_plane[3]};
+  return !inliers.indices.empty();
+}
+
+bool ParallelPlaneRansac::isValid(const Eigen::Vector3f& normal) const
+{
+  return eps_angle_ <= 0.0f || std::abs(normal.dot(axis_)) >= std::cos(eps_angle_);
+}
+
+void ParallelPlaneRansac::startWorkers()
+{
+  stop_ = false;
+  for(unsigned int i = 1; i < num_threads_; ++i)
+    workers_.emplace_back(&ParallelPlaneRansac::workerLoop, this, batch_id_);
+}
+
+void ParallelPlaneRansac::stopWorkers()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  batch_cv_.notify_all();
+  for(std::thread& worker : workers_)
+    worker.join();
+  workers_.clear();
+}
+
+void ParallelPlaneRansac::workerLoop(unsigned long last_batch)
+{
+  while(true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      batch_cv_.wait(lock, [this, last_batch] { return stop_ || batch_id_ != last_batch; });
+      if(stop_)
+        return;
+      last_batch = batch_id_;
+    }
+
+    scoreBatch();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --busy_workers_;
+    }
+    done_cv_.notify_one();
+  }
+}
+
+void ParallelPlaneRansac::scoreBatch()
+{
+  int h;
+  while((h = next_hypothesis_.fetch_add(1)) < batch_hypotheses_)
+    scores_[h] = hypotheses_[h].head<3>().isZero() ? 0 : countInliers(hypotheses_[h]);
+}
+
+int ParallelPlaneRansac::countInliers(const Eigen::Vector4f& plane) const
+{
+  // branch free over contiguous arrays, vectorized by the compiler
+  const float a = plane[0], b = plane[1], c = plane[2], d = plane[3];
+  const float threshold = distance_threshold_;
+  const float* x = x_.data();
+  const float* y = y_.data();
+  const float* z = z_.data();
+  const int n = static_cast<int>(x_.size());
+
+  int count = 0;
+  for(int i = 0; i < n; ++i)
+    count += std::abs(a * x[i] + b * y[i] + c * z[i] + d) <= threshold;
+  return count;
+}
+
+void ParallelPlaneRansac::selectInliers(const Eigen::Vector4f& plane, pcl::PointIndices& inliers) const
+{
+  inliers.indices.clear();
+  for(size_t i = 0; i < x_.size(); ++i)
+  {
+    if(std::abs(plane[0] * x_[i] + plane[1] * y_[i] + plane[2] * z_[i] + plane[3]) <= distance_threshold_)
+      inliers.indices.push_back(indices_ ? (*indices_)[i] : static_cast<int>(i));
+  }
+}
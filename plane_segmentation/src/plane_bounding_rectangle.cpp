@@ -0,0 +1,223 @@
+#include <plane_segmentation/plane_bounding_rectangle.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+/**
+ * @brief z component of (a - o) x (b - o), > 0 for a counter clockwise turn
+ */
+inline float cross(const Eigen::Vector2f& o, const Eigen::Vector2f& a, const Eigen::Vector2f& b)
+{
+  return (a.x() - o.x()) * (b.y() - o.y()) - (a.y() - o.y()) * (b.x() - o.x());
+}
+
+}  // namespace
+
+PlaneBoundingRectangle::PlaneBoundingRectangle(size_t max_points) :
+  max_points_(max_points),
+  origin_(Eigen::Vector3f::Zero()),
+  u_(Eigen::Vector3f::UnitX()),
+  v_(Eigen::Vector3f::UnitY()),
+  n_(Eigen::Vector3f::UnitZ()),
+  center_(Eigen::Vector2f::Zero()),
+  axis_(Eigen::Vector2f::UnitX()),
+  length_(0.0f),
+  width_(0.0f)
+{
+}
+
+PlaneBoundingRectangle::~PlaneBoundingRectangle()
+{
+}
+
+void PlaneBoundingRectangle::setMaxPoints(size_t max_points)
+{
+  max_points_ = max_points;
+}
+
+bool PlaneBoundingRectangle::compute(const PointCloud& input, const std::vector<int>& indices, const Eigen::Vector4f& plane)
+{
+  hull_.clear();
+  length_ = width_ = 0.0f;
+
+  Eigen::Vector3f n = plane.head<3>();
+  float norm = n.norm();
+  if(indices.size() < 3 || !(norm > 0.0f))
+    return false;
+
+  // 2D frame on the plane, normal upwards, u follows the x axis of the input frame
+  n /= norm;
+  float d = plane[3] / norm;
+  if(n.z() < 0.0f)
+  {
+    n = -n;
+    d = -d;
+  }
+  Eigen::Vector3f ref = std::abs(n.x()) < 0.9f ? Eigen::Vector3f::UnitX() : Eigen::Vector3f::UnitY();
+  n_ = n;
+  origin_ = -d * n;
+  u_ = (ref - n * n.dot(ref)).normalized();
+  v_ = n.cross(u_);
+
+  // project the (subsampled) inliers into the plane
+  size_t stride = 1;
+  if(max_points_ > 0 && indices.size() > max_points_)
+    stride = (indices.size() + max_points_ - 1) / max_points_;
+
+  points_.clear();
+  points_.reserve(indices.size() / stride + 1);
+  for(size_t i = 0; i < indices.size(); i += stride)
+  {
+    Eigen::Vector3f p = input.points[indices[i]].getVector3fMap() - origin_;
+    points_.push_back(Eigen::Vector2f(p.dot(u_), p.dot(v_)));
+  }
+
+  convexHull(points_, hull_);
+  if(hull_.size() < 3)
+    return false;
+
+  minAreaRectangle(hull_, center_, axis_, length_, width_);
+  return true;
+}
+
+Eigen::Affine3f PlaneBoundingRectangle::pose() const
+{
+  Eigen::Vector3f x = axis_.x() * u_ + axis_.y() * v_;
+  Eigen::Matrix3f R;
+  R.col(0) = x;
+  R.col(1) = n_.cross(x);
+  R.col(2) = n_;
+
+  Eigen::Affine3f T = Eigen::Affine3f::Identity();
+  T.linear() = R;
+  T.translation() = toPlane(center_);
+  return T;
+}
+
+void PlaneBoundingRectangle::corners(Points3D& corners) const
+{
+  Eigen::Vector2f a = 0.5f * length_ * axis_;
+  Eigen::Vector2f b = 0.5f * width_ * Eigen::Vector2f(-axis_.y(), axis_.x());
+
+  corners.clear();
+  corners.push_back(toPlane(center_ - a - b));
+  corners.push_back(toPlane(center_ + a - b));
+  corners.push_back(toPlane(center_ + a + b));
+  corners.push_back(toPlane(center_ - a + b));
+}
+
+void PlaneBoundingRectangle::hull(Points3D& hull) const
+{
+  hull.clear();
+  hull.reserve(hull_.size());
+  for(const Eigen::Vector2f& p : hull_)
+    hull.push_back(toPlane(p));
+}
+
+void PlaneBoundingRectangle::convexHull(Points2D& points, Points2D& hull)
+{
+  std::sort(points.begin(), points.end(), [](const Eigen::Vector2f& a, const Eigen::Vector2f& b) {
+    return a.x() < b.x() || (a.x() == b.x() && a.y() < b.y());
+  });
+  points.erase(std::unique(points.begin(), points.end()), points.end());
+
+  hull.clear();
+  size_t n = points.size();
+  if(n < 3)
+  {
+    hull.assign(points.begin(), points.end());
+    return;
+  }
+
+  // lower and upper chain, only strict left turns are kept
+  hull.resize(2 * n);
+  size_t k = 0;
+  for(size_t i = 0; i < n; ++i)
+  {
+    while(k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0.0f)
+      --k;
+    hull[k++] = points[i];
+  }
+  for(size_t i = n - 1, lower = k + 1; i > 0; --i)
+  {
+    while(k >= lower && cross(hull[k - 2], hull[k - 1], points[i - 1]) <= 0.0f)
+      --k;
+    hull[k++] = points[i - 1];
+  }
+  hull.resize(k - 1);
+}
+
+void PlaneBoundingRectangle::minAreaRectangle(const Points2D& hull,
+                                              Eigen::Vector2f& center, Eigen::Vector2f& axis,
+                                              float& length, float& width)
+{
+  size_t n = hull.size();
+  center = n > 0 ? hull[0] : Eigen::Vector2f::Zero();
+  axis = Eigen::Vector2f::UnitX();
+  length = width = 0.0f;
+  if(n < 2)
+    return;
+  if(n == 2)
+  {
+    Eigen::Vector2f e = hull[1] - hull[0];
+    center = 0.5f * (hull[0] + hull[1]);
+    length = e.norm();
+    if(length > 0.0f)
+      axis = e / length;
+    return;
+  }
+
+  // calipers: k farthest along the edge, j farthest from the edge,
+  // m farthest against the edge. All three only move forward.
+  float best_area = std::numeric_limits<float>::max();
+  size_t k = 1, j = 1, m = 1;
+  for(size_t i = 0; i < n; ++i)
+  {
+    const Eigen::Vector2f& p = hull[i];
+    Eigen::Vector2f e = hull[(i + 1) % n] - p;
+    float e_norm = e.norm();
+    if(!(e_norm > 0.0f))
+      continue;
+    e /= e_norm;
+    Eigen::Vector2f e_perp(-e.y(), e.x());    // points into the polygon
+
+    while((hull[(k + 1) % n] - hull[k]).dot(e) > 0.0f)
+      k = (k + 1) % n;
+    if(i == 0)
+      j = k;
+    while((hull[(j + 1) % n] - hull[j]).dot(e_perp) > 0.0f)
+      j = (j + 1) % n;
+    if(i == 0)
+      m = j;
+    while((hull[(m + 1) % n] - hull[m]).dot(e) < 0.0f)
+      m = (m + 1) % n;
+
+    float max_e = (hull[k] - p).dot(e);
+    float min_e = (hull[m] - p).dot(e);
+    float height = (hull[j] - p).dot(e_perp);
+    float area = (max_e - min_e) * height;
+    if(area < best_area)
+    {
+      best_area = area;
+      center = p + 0.5f * (max_e + min_e) * e + 0.5f * height * e_perp;
+      axis = e;
+      length = max_e - min_e;
+      width = height;
+    }
+  }
+
+  // length is the longer side
+  if(width > length)
+  {
+    axis = Eigen::Vector2f(-axis.y(), axis.x());
+    std::swap(length, width);
+  }
+}
+
+Eigen::Vector3f PlaneBoundingRectangle::toPlane(const Eigen::Vector2f& point) const
+{
+  return origin_ + point.x() * u_ + point.y() * v_;
+}
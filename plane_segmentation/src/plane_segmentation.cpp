@@ -1,112 +1,409 @@
-
 #include <plane_segmentation/plane_segmentation.h>
 
+#include <algorithm>
+#include <limits>
+
+PlaneSegmentation::Parameters::Parameters() :
+  pre_pass_low(-0.1f),
+  pre_pass_high(0.2f),
+  workspace_min(Eigen::Vector3f::Constant(-std::numeric_limits<float>::max())),
+  workspace_max(Eigen::Vector3f::Constant(std::numeric_limits<float>::max())),
+  seg_pass_low(0.01f),
+  seg_pass_high(0.3f),
+  ransac_threshold(0.02f),
+  parallel_ransac(true),
+  ransac_threads(0),
+  ransac_max_iterations(1000),
+  voxel_leaf_size(0.01f),
+  zero_copy_ingestion(true),
+  segmentation_method(RANSAC),
+  compare_segmentation_methods(false),
+  organized_min_inliers(1000),
+  organized_angular_threshold(2.0),
+  plane_tracking(true),
+  tracking_min_inlier_ratio(0.8f),
+  horizontal_planes(false),
+  max_plane_angle(10.0),
+  max_planes(1),
+  min_plane_inliers(500),
+  hull_max_points(5000),
+  scene_accumulation(false),
+  accumulation_frames(5),
+  accumulation_min_hits(2),
+  accumulation_max_voxels(200000)
+{
+}
+
 PlaneSegmentation::PlaneSegmentation(
     const std::string& pointcloud_topic, 
     const std::string& base_frame) :
   pointcloud_topic_(pointcloud_topic),
   base_frame_(base_frame),
-  is_cloud_updated_(false)
+  num_planes_(0),
+  processed_frames_(0),
+  processing_allocations_(0),
+  update_allocations_(0),
+  buffer_growths_(0),
+  total_buffer_growths_(0),
+  preprocessor_reallocations_(0),
+  T_base_sensor_(Eigen::Affine3f::Identity()),
+  latency_monitor_("plane_segmentation: latency")
 {
+  buffer_capacities_.fill(0);
+
+  // timing stages, registered in the order of the Stage enum
+  latency_monitor_.addStage("ingest");
+  latency_monitor_.addStage("tf_lookup");
+  latency_monitor_.addStage("preprocess");
+  latency_monitor_.addStage("publish_combined");
+  latency_monitor_.addStage("plane_fit");
+  latency_monitor_.addStage("extra_planes");
+  latency_monitor_.addStage("objects");
+  latency_monitor_.addStage("accumulate");
+  latency_monitor_.addStage("publish");
+  latency_monitor_.addStage("planes");
+  latency_monitor_.addStage("update");
+  latency_monitor_.addStage("stamp_to_publish");
+
+  raw_cloud_.reset(new PointCloud);
+  preprocessed_cloud_ = cloud_pool_.acquire();
+  plane_cloud_ = cloud_pool_.acquire();
+  objects_cloud_ = cloud_pool_.acquire();
+  accumulated_cloud_ = cloud_pool_.acquire();
+  remaining_indices_.reset(new std::vector<int>);
+  inliers_.reset(new pcl::PointIndices);
+  coefficients_.reset(new pcl::ModelCoefficients);
+
+  configure(params_);
 }
 
 PlaneSegmentation::~PlaneSegmentation()
 {
 }
 
-bool PlaneSegmentation::initalize(ros::NodeHandle& nh)
+bool PlaneSegmentation::initalize(ros::NodeHandle& nh, std::shared_ptr<TransformCache> transform_cache)
 {
   // load rosparams
+  Parameters params;
+  if(!loadParameters(params) || !configure(params))
+    return false;
+
+  transform_cache_ = transform_cache ? transform_cache : std::make_shared<TransformCache>(nh);
+
+  // clouds wait in the tf filter until the sensor pose at their stamp is
+  // known, only the latest of them is processed, older ones are dropped
+  point_cloud_sub_.subscribe(nh, pointcloud_topic_, 1);
+  tf_filter_.reset(new tf2_ros::MessageFilter<sensor_msgs::PointCloud2>(
+    point_cloud_sub_, transform_cache_->buffer(), base_frame_, 5, nh));
+  tf_filter_->registerCallback(boost::bind(&PlaneSegmentation::cloudCallback, this, _1));
+  tf_filter_->registerFailureCallback(boost::bind(&PlaneSegmentation::cloudDroppedCallback, this, _1, _2));
+
+  // pcl clouds are passed as pointers to subscribers in the same nodelet
+  // manager and only serialized (as sensor_msgs/PointCloud2) for others
+  plane_cloud_pub_ = nh.advertise<PointCloud>("/table_point_cloud", 10);
+
+  objects_cloud_pub_ = nh.advertise<PointCloud>("/objects_point_cloud", 10);
+
+  combined_cloud_pub_ = nh.advertise<PointCloud>("/combined_point_cloud", 10);
+
+  table_polygon_pub_ = nh.advertise<geometry_msgs::PolygonStamped>("/table_polygon", 10);
+
+  diagnostics_pub_ = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+
+  planes_pub_ = nh.advertise<plane_segmentation::PlaneArray>("/planes", 10);
+
+  plane_clouds_pub_ = nh.advertise<sensor_msgs::PointCloud2>("/plane_clouds", 10);
+
+  return true;
+}
+
+bool PlaneSegmentation::loadParameters(Parameters& params)
+{
   std::vector<float> pre_pass_limits; 
   std::vector<float> seg_pass_limits; 
-  if (!ros::param::get("pre_pass_filter", pre_pass_limits))
+  if (!ros::param::get("pre_pass_filter", pre_pass_limits) || pre_pass_limits.size() != 2)
+  {
+    return false;
+  }
+  if (!ros::param::get("seg_pass_filter", seg_pass_limits) || seg_pass_limits.size() != 2)
   {
     return false;
   }
-  if (!ros::param::get("seg_pass_filter", seg_pass_limits))
+  if (!ros::param::get("ransac_threshold", params.ransac_threshold))
   {
     return false;
   }
-  if (!ros::param::get("ransac_threshold", ransac_thresh_))
+  params.pre_pass_low = pre_pass_limits[0];
+  params.pre_pass_high = pre_pass_limits[1];
+  params.seg_pass_low = seg_pass_limits[0];
+  params.seg_pass_high = seg_pass_limits[1];
+
+  // optional workspace box in base frame, [x, y, z] corners
+  std::vector<float> workspace_min, workspace_max;
+  if(ros::param::get("workspace_min", workspace_min))
+  {
+    if(workspace_min.size() != 3)
+      return false;
+    params.workspace_min = Eigen::Vector3f(workspace_min[0], workspace_min[1], workspace_min[2]);
+  }
+  if(ros::param::get("workspace_max", workspace_max))
   {
+    if(workspace_max.size() != 3)
+      return false;
+    params.workspace_max = Eigen::Vector3f(workspace_max[0], workspace_max[1], workspace_max[2]);
+  }
+
+  ros::param::param<bool>("parallel_ransac", params.parallel_ransac, params.parallel_ransac);
+  ros::param::param<int>("ransac_threads", params.ransac_threads, params.ransac_threads);
+  ros::param::param<int>("ransac_max_iterations", params.ransac_max_iterations, params.ransac_max_iterations);
+  ros::param::param<bool>("zero_copy_ingestion", params.zero_copy_ingestion, params.zero_copy_ingestion);
+  ros::param::param<float>("voxel_leaf_size", params.voxel_leaf_size, params.voxel_leaf_size);
+
+  std::string segmentation_method;
+  ros::param::param<std::string>("segmentation_method", segmentation_method, "ransac");
+  if(segmentation_method == "ransac")
+    params.segmentation_method = RANSAC;
+  else if(segmentation_method == "organized")
+    params.segmentation_method = ORGANIZED;
+  else if(segmentation_method == "height_histogram")
+    params.segmentation_method = HEIGHT_HISTOGRAM;
+  else
+  {
+    ROS_ERROR_STREAM("Unknown segmentation_method " << segmentation_method << ", use ransac, organized or height_histogram");
     return false;
   }
-  pre_pass_low_ = pre_pass_limits[0];
-  pre_pass_high_ = pre_pass_limits[1];
-  seg_pass_low_ = seg_pass_limits[0];
-  seg_pass_high_ = seg_pass_limits[1];
+  ros::param::param<bool>("compare_segmentation_methods", params.compare_segmentation_methods, params.compare_segmentation_methods);
 
-  point_cloud_sub_ = nh.subscribe(pointcloud_topic_, 10, &PlaneSegmentation::cloudCallback, this);
+  ros::param::param<int>("organized_min_inliers", params.organized_min_inliers, params.organized_min_inliers);
+  ros::param::param<double>("organized_angular_threshold", params.organized_angular_threshold, params.organized_angular_threshold);
 
-  plane_cloud_pub_ = nh.advertise<sensor_msgs::PointCloud2>("/table_point_cloud", 10);
+  ros::param::param<bool>("plane_tracking", params.plane_tracking, params.plane_tracking);
+  ros::param::param<float>("tracking_min_inlier_ratio", params.tracking_min_inlier_ratio, params.tracking_min_inlier_ratio);
 
-  objects_cloud_pub_ = nh.advertise<sensor_msgs::PointCloud2>("/objects_point_cloud", 10);
+  ros::param::param<bool>("horizontal_planes", params.horizontal_planes, params.horizontal_planes);
+  ros::param::param<double>("max_plane_angle", params.max_plane_angle, params.max_plane_angle);
 
-  combined_cloud_pub_ = nh.advertise<sensor_msgs::PointCloud2>("/combined_point_cloud", 10);
+  ros::param::param<int>("max_planes", params.max_planes, params.max_planes);
+  ros::param::param<int>("min_plane_inliers", params.min_plane_inliers, params.min_plane_inliers);
 
-  plane_vertex_pub_ = nh.advertise<sensor_msgs::PointCloud2>("/table_vertices", 10);
+  ros::param::param<int>("hull_max_points", params.hull_max_points, params.hull_max_points);
 
-  raw_cloud_.reset(new PointCloud);
-  preprocessed_cloud_.reset(new PointCloud);
-  plane_cloud_.reset(new PointCloud);
-  objects_cloud_.reset(new PointCloud);
+  ros::param::param<bool>("scene_accumulation", params.scene_accumulation, params.scene_accumulation);
+  ros::param::param<int>("accumulation_frames", params.accumulation_frames, params.accumulation_frames);
+  ros::param::param<int>("accumulation_min_hits", params.accumulation_min_hits, params.accumulation_min_hits);
+  ros::param::param<int>("accumulation_max_voxels", params.accumulation_max_voxels, params.accumulation_max_voxels);
+  return true;
+}
+
+bool PlaneSegmentation::configure(const Parameters& params)
+{
+  if(!(params.voxel_leaf_size > 0.0f) || !(params.ransac_threshold > 0.0f) || params.max_planes < 1 ||
+     params.ransac_threads < 0 || (params.workspace_min.array() > params.workspace_max.array()).any() ||
+     params.accumulation_frames < 1 || params.accumulation_frames > SceneAccumulator::kMaxFrames ||
+     params.accumulation_min_hits < 1 || params.accumulation_min_hits > params.accumulation_frames ||
+     params.accumulation_max_voxels < 1)
+  {
+    ROS_ERROR_STREAM("PlaneSegmentation: voxel_leaf_size and ransac_threshold have to be positive, "
+      "max_planes at least 1, ransac_threads not negative, workspace_min not above workspace_max, "
+      "accumulation_frames in [1, " << SceneAccumulator::kMaxFrames << "], accumulation_min_hits in "
+      "[1, accumulation_frames] and accumulation_max_voxels positive");
+    return false;
+  }
+  // restarting the workers is only needed for a new thread count
+  if(params.ransac_threads != params_.ransac_threads)
+    plane_ransac_.setNumThreads(params.ransac_threads);
+  params_ = params;
+
+  plane_ransac_.setDistanceThreshold(params_.ransac_threshold);
+  plane_ransac_.setMaxIterations(params_.ransac_max_iterations);
+
+  // the base frame z axis is against gravity, horizontal planes have a normal along it
+  float max_plane_angle = params_.max_plane_angle * M_PI / 180.0;
+  plane_ransac_.setAxis(Eigen::Vector3f::UnitZ());
+  plane_ransac_.setEpsAngle(params_.horizontal_planes ? max_plane_angle : 0.0f);
+  horizontal_detector_.setDistanceThreshold(params_.ransac_threshold);
+  horizontal_detector_.setMaxAngle(max_plane_angle);
+
+  sac_segmentation_.setOptimizeCoefficients(true);
+  sac_segmentation_.setMethodType(pcl::SAC_RANSAC);
+  sac_segmentation_.setDistanceThreshold(params_.ransac_threshold);
+  if(params_.horizontal_planes)
+  {
+    sac_segmentation_.setModelType(pcl::SACMODEL_PERPENDICULAR_PLANE);
+    sac_segmentation_.setAxis(Eigen::Vector3f::UnitZ());
+    sac_segmentation_.setEpsAngle(max_plane_angle);
+  }
+  else
+    sac_segmentation_.setModelType(pcl::SACMODEL_PLANE);
 
+  cloud_preprocessor_.setLeafSize(params_.voxel_leaf_size);
+  cloud_preprocessor_.setFilterLimits(params_.pre_pass_low, params_.pre_pass_high);
+  cloud_preprocessor_.setWorkspace(params_.workspace_min, params_.workspace_max);
+
+  organized_segmenter_.setMinInliers(params_.organized_min_inliers);
+  organized_segmenter_.setAngularThreshold(params_.organized_angular_threshold * M_PI / 180.0);
+  organized_segmenter_.setDistanceThreshold(params_.ransac_threshold);
+
+  plane_tracker_.setDistanceThreshold(params_.ransac_threshold);
+  plane_tracker_.setMinInlierRatio(params_.tracking_min_inlier_ratio);
+  plane_tracker_.reset();
+
+  bounding_rectangle_.setMaxPoints(params_.hull_max_points);
+
+  // objects are fused in the voxel grid of the preprocessing, starts empty
+  scene_accumulator_.setFrames(params_.accumulation_frames);
+  scene_accumulator_.setMinHits(params_.accumulation_min_hits);
+  scene_accumulator_.setMaxVoxels(params_.accumulation_max_voxels);
+  scene_accumulator_.setLeafSize(params_.voxel_leaf_size);
   return true;
 }
 
+bool PlaneSegmentation::waitForCloud(const ros::Duration& timeout)
+{
+  return cloud_slot_.waitFor(timeout.toSec());
+}
+
 void PlaneSegmentation::update(const ros::Time& time)
 {
   // update as soon as new pointcloud is available
-  if(is_cloud_updated_)
+  sensor_msgs::PointCloud2ConstPtr raw_cloud_msg;
+  if(cloud_slot_.take(raw_cloud_msg))
   {
-    is_cloud_updated_ = false;
+    ScopedStageTimer update_timer(latency_monitor_, STAGE_UPDATE);
+    uint64_t update_allocations = AllocationCounter::count();
+
+    // sensor pose at the time of the cloud
+    Eigen::Affine3f T_base_sensor;
+    {
+      ScopedStageTimer timer(latency_monitor_, STAGE_TF_LOOKUP);
+      if(!lookupSensorTransform(raw_cloud_msg->header, T_base_sensor))
+        return;
+    }
 
     // apply all preprocessing steps
-    if(!preProcessCloud(raw_cloud_, preprocessed_cloud_))
+    if(!preprocess(raw_cloud_msg, T_base_sensor))
       return;
 
     // publish the preprocessed point cloud for gpd
-    sensor_msgs::PointCloud2 pre_processed_cloud_msg;
-    pcl::toROSMsg(*preprocessed_cloud_, pre_processed_cloud_msg);
-    combined_cloud_pub_.publish(pre_processed_cloud_msg);
+    if(combined_cloud_pub_.getNumSubscribers() > 0)
+    {
+      ScopedStageTimer timer(latency_monitor_, STAGE_PUBLISH_COMBINED);
+      combined_cloud_pub_.publish(preprocessed_cloud_);
+    }
 
     // segment cloud into table and objects
-    if(!segmentCloud(preprocessed_cloud_, plane_cloud_, objects_cloud_))
-      return;
+    if(segment())
+    {
+      {
+        ScopedStageTimer timer(latency_monitor_, STAGE_PUBLISH);
+        if(plane_cloud_pub_.getNumSubscribers() > 0)
+          plane_cloud_pub_.publish(plane_cloud_);
+        if(objects_cloud_pub_.getNumSubscribers() > 0)
+          objects_cloud_pub_.publish(params_.scene_accumulation ? accumulated_cloud_ : objects_cloud_);
+      }
+      latency_monitor_.record(STAGE_STAMP_TO_PUBLISH, (ros::Time::now() - raw_cloud_msg->header.stamp).toSec());
+
+      // coefficients, hulls and bounding rectangles of all planes
+      publishPlanes();
+    }
+
+    update_allocations_ = AllocationCounter::count() - update_allocations;
+  }
+
+  publishDiagnostics(time);
+}
+
+bool PlaneSegmentation::process(const sensor_msgs::PointCloud2ConstPtr& input, const Eigen::Affine3f& T_base_sensor)
+{
+  if(!preprocess(input, T_base_sensor) || !segment())
+    return false;
+  describePlanes();
+  return true;
+}
+
+bool PlaneSegmentation::preprocess(const sensor_msgs::PointCloud2ConstPtr& input, const Eigen::Affine3f& T_base_sensor)
+{
+  T_base_sensor_ = T_base_sensor;
+  processing_allocations_ = 0;
 
-    sensor_msgs::PointCloud2 plane_cloud_msg;
-    sensor_msgs::PointCloud2 objects_cloud_msg;
-    pcl::toROSMsg(*plane_cloud_, plane_cloud_msg);
-    pcl::toROSMsg(*objects_cloud_, objects_cloud_msg);
+  // published clouds must not change while a subscriber still holds them
+  cloud_pool_.reclaim(preprocessed_cloud_);
+  cloud_pool_.reclaim(plane_cloud_);
+  cloud_pool_.reclaim(objects_cloud_);
+  cloud_pool_.reclaim(accumulated_cloud_);
 
-    plane_cloud_pub_.publish(plane_cloud_msg);
-    objects_cloud_pub_.publish(objects_cloud_msg);
+  // the organized segmentation needs the full resolution sensor cloud
+  bool needs_raw_cloud = params_.segmentation_method == ORGANIZED || params_.compare_segmentation_methods;
+  if(params_.zero_copy_ingestion && !needs_raw_cloud)
+    return preProcessCloud(input, preprocessed_cloud_);
+
+  {
+    ScopedStageTimer timer(latency_monitor_, STAGE_INGEST);
+    pcl::fromROSMsg(*input, *raw_cloud_);
   }
+  return preProcessCloud(raw_cloud_, preprocessed_cloud_);
+}
+
+bool PlaneSegmentation::segment()
+{
+  uint64_t allocations = AllocationCounter::count();
+  bool segmented = segmentCloud(preprocessed_cloud_, plane_cloud_, objects_cloud_);
+  if(segmented && params_.scene_accumulation)
+  {
+    // frames without table are not accumulated, they neither add nor age voxels
+    ScopedStageTimer timer(latency_monitor_, STAGE_ACCUMULATE);
+    scene_accumulator_.add(*objects_cloud_);
+    scene_accumulator_.extract(*accumulated_cloud_);
+  }
+  processing_allocations_ += AllocationCounter::count() - allocations;
+  updateBufferGrowths();
+  ++processed_frames_;
+  return segmented;
 }
 
 bool PlaneSegmentation::preProcessCloud(CloudPtr& input, CloudPtr& output)
 {
-  // Subsample and Filter the pointcloud
-  CloudPtr ds_cloud(new PointCloud);            // downsampled pointcloud
+  // Subsample, transform and filter the pointcloud in a single pass
+  ScopedStageTimer timer(latency_monitor_, STAGE_PREPROCESS);
+  cloud_preprocessor_.setTransform(T_base_sensor_);
+  uint64_t allocations = AllocationCounter::count();
+  bool success = cloud_preprocessor_.process(*input, *output);
+  processing_allocations_ += AllocationCounter::count() - allocations;
+  if(!success)
+    return false;
 
-  // create voxel grid filtering object
-  pcl::VoxelGrid<PointT> sor;
-  sor.setInputCloud(input);
-  sor.setLeafSize(0.01f, 0.01f, 0.01f);
-  sor.filter(*ds_cloud);
+  output->header.frame_id = base_frame_;
+  return true;
+}
 
-  CloudPtr transf_cloud(new PointCloud);        // transformed pointcloud (expressed in base frame)
+bool PlaneSegmentation::preProcessCloud(const sensor_msgs::PointCloud2ConstPtr& input, CloudPtr& output)
+{
+  // Subsample, transform and filter straight from the message buffer
+  ScopedStageTimer timer(latency_monitor_, STAGE_PREPROCESS);
+  cloud_preprocessor_.setTransform(T_base_sensor_);
+  uint64_t allocations = AllocationCounter::count();
+  bool success = cloud_preprocessor_.process(*input, *output);
+  processing_allocations_ += AllocationCounter::count() - allocations;
+  if(!success)
+    return false;
 
-  // Transform the point cloud to the base_frame link.
-  pcl_ros::transformPointCloud(base_frame_, *ds_cloud, *transf_cloud, tfListener_);
+  output->header.frame_id = base_frame_;
+  return true;
+}
 
-  // create pass through filtering object 
-  pcl::PassThrough<PointT> pass;
-  pass.setInputCloud(transf_cloud);
-  pass.setFilterFieldName("z");
-  pass.setFilterLimits(pre_pass_low_, pre_pass_high_);
-  pass.filter(*output);
+bool PlaneSegmentation::lookupSensorTransform(const std_msgs::Header& header, Eigen::Affine3f& T_base_sensor)
+{
+  if(header.frame_id == base_frame_)
+  {
+    T_base_sensor = Eigen::Affine3f::Identity();
+    return true;
+  }
 
+  // exact stamp of the cloud, available once the cloud passed the tf filter
+  Eigen::Affine3d T;
+  if(!transform_cache_->lookup(base_frame_, header.frame_id, header.stamp, T))
+    return false;
+  T_base_sensor = T.cast<float>();
   return true;
 }
 
@@ -114,91 +411,491 @@ bool PlaneSegmentation::segmentCloud(CloudPtr& input, CloudPtr& plane_cloud, Clo
 {
   // Remove every point that is not an object from the objects_cloud cloud
 
-  // We will use Ransac to segment the pointcloud, here we setup the objects we need for this
-  pcl::SACSegmentation<PointT> seg;
-  pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
-  pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-
-  seg.setOptimizeCoefficients(true);
-  seg.setModelType(pcl::SACMODEL_PLANE);
-  seg.setMethodType (pcl::SAC_RANSAC);
-  seg.setDistanceThreshold(ransac_thresh_);
-  seg.setInputCloud(input);
-  seg.segment(*inliers, *coefficients);
-
-  pcl::ExtractIndices<PointT> extract;
-  extract.setInputCloud(input);
-  extract.setIndices(inliers);
-
-  // obtain points that belong to floor
-  extract.setNegative(false); // extract inliers
-  extract.filter(*plane_cloud);
-
-  // obtain the corner coordinates of the plane
-  pcl::ConvexHull<PointT> chull;
-  chull.setInputCloud(plane_cloud);
-  pcl::PointCloud<PointT>::Ptr chull_points(new pcl::PointCloud<PointT>);
-  chull.reconstruct(*chull_points);
-
-  // get the min and max points of the bounding box
-  PointT min_point, max_point;
-  pcl::getMinMax3D(*chull_points, min_point, max_point);
-
-  // Create the two corner points of the bounding box
-  pcl::PointCloud<PointT>::Ptr corner_points(new pcl::PointCloud<PointT>);
-  corner_points->push_back(min_point);
-  corner_points->push_back(max_point);
-
-  // display the corners of the plane
-  sensor_msgs::PointCloud2 corners_msg;
-  pcl::toROSMsg(*corner_points, corners_msg);
-  corners_msg.header.frame_id = "base_footprint";  // Set the frame_id as appropriate
-  plane_vertex_pub_.publish(corners_msg);
-
-  // obtain everything other than the floor
-  extract.setNegative(true); // extract outliers
-  extract.filter(*objects_cloud);
-  
-  // Next, we further refine the the objects_cloud by transforming it into the coordinate frame
-  // of the fitted plane. Basically, a table aligned bounding box
-
-  if(coefficients->values.empty())
-    return false;
+  // Find the table plane with the selected method
+  pcl::PointIndices& inliers = *inliers_;
+  pcl::ModelCoefficients& coefficients = *coefficients_;
+  {
+    ScopedStageTimer timer(latency_monitor_, STAGE_PLANE_FIT);
+    if(!fitPlane(input, inliers, coefficients))
+      return false;
+  }
+
+  // further planes (shelf levels, other tables) in the remaining points
+  {
+    ScopedStageTimer timer(latency_monitor_, STAGE_EXTRA_PLANES);
+    extractPlanes(input, inliers, coefficients);
+  }
+
+  ScopedStageTimer timer(latency_monitor_, STAGE_OBJECTS);
+
+  // obtain points that belong to the table
+  plane_cloud->clear();
+  plane_cloud->header = input->header;
+  plane_cloud->reserve(inliers.indices.size());
+  for(int idx : inliers.indices)
+    plane_cloud->push_back(input->points[idx]);
+  plane_cloud->is_dense = true;
+
+  // Next, we keep the points within the height band above the table. The z
+  // coordinate of a point in the frame of the fitted plane is its signed
+  // distance n * p + d, so the band is checked directly in base frame while
+  // collecting everything other than the planes.
+  Eigen::Vector3f n{coefficients.values[0], coefficients.values[1], coefficients.values[2]};
+  float d = coefficients.values[3];
+  float n_norm = n.norm();
+  n /= n_norm;
+  d /= n_norm;
+
+  // the sign of the fitted normal is arbitrary, heights are measured upwards
+  if(n.z() < 0.0f)
+  {
+    n = -n;
+    d = -d;
+  }
+
+  objects_cloud->clear();
+  objects_cloud->header = input->header;
+  objects_cloud->reserve(remaining_indices_->size());
+  for(int idx : *remaining_indices_)
+  {
+    const PointT& pt = input->points[idx];
+    float height = n.dot(pt.getVector3fMap()) + d;
+    if(height >= params_.seg_pass_low && height <= params_.seg_pass_high)
+      objects_cloud->push_back(pt);
+  }
+  objects_cloud->is_dense = true;
+
+  return true;
+}
+
+void PlaneSegmentation::extractPlanes(CloudPtr& input, const pcl::PointIndices& inliers, const pcl::ModelCoefficients& coefficients)
+{
+  // slots are only added, never removed, and assigned in place so they
+  // keep the capacity of the previous frames
+  if(plane_inliers_.size() < static_cast<size_t>(params_.max_planes))
+  {
+    plane_coefficients_.resize(params_.max_planes);
+    plane_inliers_.resize(params_.max_planes);
+  }
+  num_planes_ = 1;
+  plane_coefficients_[0] = coefficients;
+  plane_inliers_[0] = inliers;
+
+  // mask out the primary plane, everything else remains
+  plane_mask_.assign(input->size(), 0);
+  for(int idx : inliers.indices)
+    plane_mask_[idx] = 1;
+
+  std::vector<int>& remaining = *remaining_indices_;
+  remaining.clear();
+  remaining.reserve(input->size());
+  for(size_t i = 0; i < plane_mask_.size(); ++i)
+  {
+    if(!plane_mask_[i])
+      remaining.push_back(static_cast<int>(i));
+  }
+
+  while(static_cast<int>(num_planes_) < params_.max_planes &&
+        static_cast<int>(remaining.size()) >= params_.min_plane_inliers)
+  {
+    // written straight into the next slot, only counted if large enough
+    pcl::PointIndices& plane_inliers = plane_inliers_[num_planes_];
+    pcl::ModelCoefficients& plane_coefficients = plane_coefficients_[num_planes_];
+    if(params_.segmentation_method == HEIGHT_HISTOGRAM)
+      horizontal_detector_.detect(*input, remaining, plane_inliers, plane_coefficients);
+    else if(params_.parallel_ransac)
+      plane_ransac_.segment(*input, remaining, plane_inliers, plane_coefficients);
+    else
+    {
+      // the pointer is shared, pcl does not copy the indices
+      sac_segmentation_.setInputCloud(input);
+      sac_segmentation_.setIndices(remaining_indices_);
+      sac_segmentation_.segment(plane_inliers, plane_coefficients);
+    }
+    if(static_cast<int>(plane_inliers.indices.size()) < params_.min_plane_inliers)
+      break;
+
+    // drop the new plane from the remaining indices, in place
+    for(int idx : plane_inliers.indices)
+      plane_mask_[idx] = 1;
+    remaining.erase(std::remove_if(remaining.begin(), remaining.end(),
+      [this](int idx) { return plane_mask_[idx] != 0; }), remaining.end());
+    ++num_planes_;
+  }
+}
+
+void PlaneSegmentation::describePlanes(bool hulls, bool plane_clouds)
+{
+  ScopedStageTimer timer(latency_monitor_, STAGE_PLANES);
+  const PointCloud& input = *preprocessed_cloud_;
+
+  std_msgs::Header header;
+  pcl_conversions::fromPCL(input.header, header);
+
+  planes_msg_.header = header;
+  planes_msg_.planes.clear();
+  table_polygon_.header = header;
+  table_polygon_.polygon.points.clear();
+
+  plane_clouds_.clear();
+  plane_clouds_.header = input.header;
+
+  PlaneBoundingRectangle::Points3D& vertices = plane_vertices_;
+  for(size_t i = 0; i < num_planes_; ++i)
+  {
+    const std::vector<float>& values = plane_coefficients_[i].values;
+    if(values.size() != 4)
+      continue;
+
+    plane_segmentation::Plane plane;
+    plane.header = header;
+    std::copy(values.begin(), values.end(), plane.coefficients.begin());
+    plane.num_inliers = plane_inliers_[i].indices.size();
+
+    // hull and minimum area rectangle on the plane
+    if(hulls && bounding_rectangle_.compute(input, plane_inliers_[i].indices,
+                                   Eigen::Vector4f(values[0], values[1], values[2], values[3])))
+    {
+      bounding_rectangle_.hull(vertices);
+      for(const Eigen::Vector3f& vertex : vertices)
+      {
+        geometry_msgs::Point32 point;
+        point.x = vertex.x();
+        point.y = vertex.y();
+        point.z = vertex.z();
+        plane.hull.points.push_back(point);
+      }
+
+      Eigen::Affine3f pose = bounding_rectangle_.pose();
+      Eigen::Quaternionf orientation(pose.linear());
+      plane.pose.position.x = pose.translation().x();
+      plane.pose.position.y = pose.translation().y();
+      plane.pose.position.z = pose.translation().z();
+      plane.pose.orientation.x = orientation.x();
+      plane.pose.orientation.y = orientation.y();
+      plane.pose.orientation.z = orientation.z();
+      plane.pose.orientation.w = orientation.w();
+      plane.dimensions.x = bounding_rectangle_.length();
+      plane.dimensions.y = bounding_rectangle_.width();
+
+      // the oriented table rectangle, used for the collision object
+      if(i == 0)
+      {
+        bounding_rectangle_.corners(vertices);
+        for(const Eigen::Vector3f& vertex : vertices)
+        {
+          geometry_msgs::Point32 point;
+          point.x = vertex.x();
+          point.y = vertex.y();
+          point.z = vertex.z();
+          table_polygon_.polygon.points.push_back(point);
+        }
+      }
+    }
+    planes_msg_.planes.push_back(plane);
+
+    if(!plane_clouds)
+      continue;
+    for(int idx : plane_inliers_[i].indices)
+    {
+      const PointT& pt = input.points[idx];
+      pcl::PointXYZRGBL labeled;
+      labeled.x = pt.x;
+      labeled.y = pt.y;
+      labeled.z = pt.z;
+      labeled.rgba = pt.rgba;
+      labeled.label = i;
+      plane_clouds_.push_back(labeled);
+    }
+  }
+}
 
-  Eigen::Vector3f n{coefficients->values[0], coefficients->values[1], coefficients->values[2]}; // = ?
-  double d{coefficients->values[3]}; // = ?
-  
-  // Now we construct an Eigen::Affine3f transformation T_plane_base that describes the floor plane 
-  // with respect to the base_link frame using n and d
-  Eigen::Quaternionf Q_plane_base = Eigen::Quaternionf::FromTwoVectors(n, Eigen::Vector3f{0.0, 0.0, 1.0}); // = ?
-
-  Eigen::Vector3f t_plane_base = d * n; // = ?
-
-  // Finally we create the Homogenous transformation of the table
-  Eigen::Affine3f T_plane_base = Eigen::Affine3f::Identity();
-  T_plane_base.rotate(Q_plane_base.toRotationMatrix());
-  T_plane_base.translate(t_plane_base);
-  
-  CloudPtr transf_cloud(new PointCloud);
-  pcl::transformPointCloud(*objects_cloud, *transf_cloud, T_plane_base);
-  
-  CloudPtr filterd_cloud(new PointCloud);
-
-  // create pass through filtering object 
-  pcl::PassThrough<PointT> pass;
-  pass.setInputCloud(transf_cloud);
-  pass.setFilterFieldName("z");
-  pass.setFilterLimits(seg_pass_low_, seg_pass_high_);
-  pass.filter(*filterd_cloud);
-
-  Eigen::Affine3f T_base_plane = T_plane_base.inverse();
-  pcl::transformPointCloud(*filterd_cloud, *objects_cloud, T_base_plane);
+void PlaneSegmentation::publishPlanes()
+{
+  // mostly debug outputs, skip the hulls and conversions nobody listens to
+  bool planes = planes_pub_.getNumSubscribers() > 0;
+  bool table_polygon = table_polygon_pub_.getNumSubscribers() > 0;
+  bool plane_clouds = plane_clouds_pub_.getNumSubscribers() > 0;
+  if(!planes && !table_polygon && !plane_clouds)
+    return;
+
+  describePlanes(planes || table_polygon, plane_clouds);
+
+  if(planes)
+    planes_pub_.publish(planes_msg_);
+  if(table_polygon && !table_polygon_.polygon.points.empty())
+    table_polygon_pub_.publish(table_polygon_);
+  if(plane_clouds)
+  {
+    sensor_msgs::PointCloud2 plane_clouds_msg;
+    pcl::toROSMsg(plane_clouds_, plane_clouds_msg);
+    plane_clouds_pub_.publish(plane_clouds_msg);
+  }
+}
 
+bool PlaneSegmentation::fitPlane(CloudPtr& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients)
+{
+  if(!params_.plane_tracking)
+    return detectPlane(input, inliers, coefficients);
+
+  // steady state: refine the plane of the previous frame
+  ros::WallTime start = ros::WallTime::now();
+  if(plane_tracker_.track(*input, inliers, coefficients))
+  {
+    // the refit is not limited to horizontal planes, a plane that tilted past the limit is detected again
+    float min_normal_z = params_.horizontal_planes ? std::cos(params_.max_plane_angle * M_PI / 180.0) : -1.0f;
+    if(std::abs(coefficients.values[2]) >= min_normal_z)
+    {
+      ROS_DEBUG_STREAM("PlaneSegmentation: plane tracked " << (ros::WallTime::now() - start).toSec() * 1e3
+        << " ms, " << inliers.indices.size() << " inliers");
+      return true;
+    }
+    ROS_DEBUG("PlaneSegmentation: tracked plane exceeds max_plane_angle");
+  }
+
+  // plane lost or moved, segment from scratch and use the result as new reference
+  if(!detectPlane(input, inliers, coefficients))
+  {
+    plane_tracker_.reset();
+    return false;
+  }
+  plane_tracker_.setPlane(coefficients, inliers.indices.size(), input->size());
   return true;
 }
 
+bool PlaneSegmentation::detectPlane(CloudPtr& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients)
+{
+  if(params_.segmentation_method == HEIGHT_HISTOGRAM)
+  {
+    ros::WallTime start = ros::WallTime::now();
+    bool success = fitPlaneHistogram(input, inliers, coefficients);
+    ROS_DEBUG_STREAM("PlaneSegmentation: height histogram plane fit " << (ros::WallTime::now() - start).toSec() * 1e3
+      << " ms, " << inliers.indices.size() << " inliers");
+    return success;
+  }
+
+  bool is_organized = raw_cloud_->isOrganized();
+  bool use_organized = params_.segmentation_method == ORGANIZED && is_organized;
+  if(params_.segmentation_method == ORGANIZED && !is_organized)
+    ROS_WARN_THROTTLE(5.0, "PlaneSegmentation: input cloud is not organized, falling back to RANSAC");
+
+  ros::WallTime start = ros::WallTime::now();
+  bool success = use_organized ?
+    fitPlaneOrganized(input, inliers, coefficients) :
+    fitPlaneRansac(input, inliers, coefficients);
+  double time_ms = (ros::WallTime::now() - start).toSec() * 1e3;
+
+  if(!params_.compare_segmentation_methods || !is_organized)
+  {
+    ROS_DEBUG_STREAM("PlaneSegmentation: " << (use_organized ? "organized" : "ransac") << " plane fit "
+      << time_ms << " ms, " << inliers.indices.size() << " inliers");
+    return success;
+  }
+
+  // run the other method on the same frame, only to report its timing
+  pcl::PointIndices& other_inliers = compare_inliers_;
+  pcl::ModelCoefficients& other_coefficients = compare_coefficients_;
+  start = ros::WallTime::now();
+  if(use_organized)
+    fitPlaneRansac(input, other_inliers, other_coefficients);
+  else
+    fitPlaneOrganized(input, other_inliers, other_coefficients);
+  double other_time_ms = (ros::WallTime::now() - start).toSec() * 1e3;
+
+  const pcl::PointIndices& ransac_inliers = use_organized ? other_inliers : inliers;
+  const pcl::PointIndices& organized_inliers = use_organized ? inliers : other_inliers;
+  ROS_INFO_STREAM("PlaneSegmentation: plane fit ransac "
+    << (use_organized ? other_time_ms : time_ms) << " ms (" << ransac_inliers.indices.size() << " inliers), organized "
+    << (use_organized ? time_ms : other_time_ms) << " ms (" << organized_inliers.indices.size() << " inliers)");
+  return success;
+}
+
+bool PlaneSegmentation::fitPlaneRansac(CloudPtr& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients)
+{
+  // hypotheses are scored on all cores
+  if(params_.parallel_ransac)
+    return plane_ransac_.segment(*input, inliers, coefficients);
+
+  // We will use Ransac to segment the pointcloud, the segmenter is set up in configure()
+  sac_segmentation_.setInputCloud(input);
+  sac_segmentation_.setIndices(pcl::IndicesPtr());
+  sac_segmentation_.segment(inliers, coefficients);
+
+  return !coefficients.values.empty();
+}
+
+bool PlaneSegmentation::fitPlaneHistogram(CloudPtr& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients)
+{
+  return horizontal_detector_.detect(*input, inliers, coefficients);
+}
+
+bool PlaneSegmentation::fitPlaneOrganized(CloudPtr& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients)
+{
+  inliers.indices.clear();
+  coefficients.values.clear();
+
+  std::vector<pcl::ModelCoefficients> planes;
+  std::vector<pcl::PointIndices> plane_inliers;
+  if(!organized_segmenter_.segment(raw_cloud_, planes, plane_inliers))
+    return false;
+
+  // express the largest (horizontal) plane in base frame: n_base = R n, d_base = d - n_base * t
+  float min_normal_z = params_.horizontal_planes ? std::cos(params_.max_plane_angle * M_PI / 180.0) : -1.0f;
+  Eigen::Vector3f n;
+  float d;
+  size_t i = 0;
+  for(; i < planes.size(); ++i)
+  {
+    const std::vector<float>& plane = planes[i].values;
+    n = T_base_sensor_.linear() * Eigen::Vector3f(plane[0], plane[1], plane[2]);
+    d = plane[3] - n.dot(T_base_sensor_.translation());
+
+    // orient the normal upwards, away from the floor
+    if(n.z() < 0.0f)
+    {
+      n = -n;
+      d = -d;
+    }
+    if(n.z() >= min_normal_z)
+      break;
+  }
+  if(i == planes.size())
+    return false;
+
+  // the plane points of the preprocessed cloud
+  for(size_t i = 0; i < input->points.size(); ++i)
+  {
+    if(std::abs(n.dot(input->points[i].getVector3fMap()) + d) <= params_.ransac_threshold)
+      inliers.indices.push_back(static_cast<int>(i));
+  }
+  inliers.header = input->header;
+
+  coefficients.header = input->header;
+  coefficients.values = {n.x(), n.y(), n.z(), d};
+  return !inliers.indices.empty();
+}
+
+void PlaneSegmentation::updateBufferGrowths()
+{
+  // persistent point buffers (Eigen::aligned_allocator, not seen by the allocation counter)
+  const size_t capacities[kNumBuffers] = {
+    raw_cloud_->points.capacity(),
+    preprocessed_cloud_->points.capacity(),
+    plane_cloud_->points.capacity(),
+    objects_cloud_->points.capacity(),
+    accumulated_cloud_->points.capacity(),
+    plane_clouds_.points.capacity()
+  };
+
+  buffer_growths_ = cloud_preprocessor_.reallocations() - preprocessor_reallocations_;
+  preprocessor_reallocations_ = cloud_preprocessor_.reallocations();
+  for(size_t i = 0; i < kNumBuffers; ++i)
+  {
+    if(capacities[i] > buffer_capacities_[i])
+      ++buffer_growths_;
+    buffer_capacities_[i] = capacities[i];
+  }
+  total_buffer_growths_ += buffer_growths_;
+}
+
+void PlaneSegmentation::publishDiagnostics(const ros::Time& time)
+{
+  if(time - last_diagnostics_time_ < ros::Duration(1.0))
+    return;
+  last_diagnostics_time_ = time;
+
+  diagnostic_msgs::DiagnosticArray diagnostics;
+  diagnostics.header.stamp = time;
+  diagnostic_msgs::KeyValue value;
+
+  if(params_.plane_tracking)
+  {
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name = "plane_segmentation: plane tracker";
+    status.hardware_id = base_frame_;
+    status.level = plane_tracker_.state() == PlaneTracker::NO_PLANE ?
+      diagnostic_msgs::DiagnosticStatus::WARN : diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = plane_tracker_.stateName();
+
+    value.key = "hit_rate";
+    value.value = std::to_string(plane_tracker_.hitRate());
+    status.values.push_back(value);
+    value.key = "tracked_frames";
+    value.value = std::to_string(plane_tracker_.trackedFrames());
+    status.values.push_back(value);
+    value.key = "full_fits";
+    value.value = std::to_string(plane_tracker_.fullFits());
+    status.values.push_back(value);
+    value.key = "inlier_ratio";
+    value.value = std::to_string(plane_tracker_.inlierRatio());
+    status.values.push_back(value);
+    value.key = "reference_inlier_ratio";
+    value.value = std::to_string(plane_tracker_.referenceInlierRatio());
+    status.values.push_back(value);
+    diagnostics.status.push_back(status);
+  }
+
+  // heap usage of the last frame: processing is preprocessing + segmentation,
+  // the update additionally contains tf lookup, message conversion and publishing
+  diagnostic_msgs::DiagnosticStatus memory;
+  memory.name = "plane_segmentation: memory";
+  memory.hardware_id = base_frame_;
+  memory.level = diagnostic_msgs::DiagnosticStatus::OK;
+  // without the counting operator new (e.g. in a nodelet manager) only the
+  // buffer growths are known
+  bool counted = AllocationCounter::available();
+  if(buffer_growths_ > 0 || (counted && processing_allocations_ > 0))
+    memory.message = "allocating";
+  else
+    memory.message = counted ? "steady state" : "no buffer growths, allocation counting unavailable";
+
+  value.key = "processed_frames";
+  value.value = std::to_string(processed_frames_);
+  memory.values.push_back(value);
+  value.key = "processing_allocations";
+  value.value = counted ? std::to_string(processing_allocations_) : "unavailable";
+  memory.values.push_back(value);
+  value.key = "update_allocations";
+  value.value = counted ? std::to_string(update_allocations_) : "unavailable";
+  memory.values.push_back(value);
+  value.key = "buffer_growths";
+  value.value = std::to_string(buffer_growths_);
+  memory.values.push_back(value);
+  value.key = "total_buffer_growths";
+  value.value = std::to_string(total_buffer_growths_);
+  memory.values.push_back(value);
+  if(params_.scene_accumulation)
+  {
+    value.key = "accumulated_voxels";
+    value.value = std::to_string(scene_accumulator_.size());
+    memory.values.push_back(value);
+    value.key = "accumulation_dropped_points";
+    value.value = std::to_string(scene_accumulator_.droppedPoints());
+    memory.values.push_back(value);
+    if(scene_accumulator_.droppedPoints() > 0)
+    {
+      memory.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      memory.message = "accumulation voxel map full";
+    }
+  }
+  diagnostics.status.push_back(memory);
+
+  diagnostic_msgs::DiagnosticStatus latency;
+  latency_monitor_.getStatus(latency);
+  latency.hardware_id = base_frame_;
+  diagnostics.status.push_back(latency);
+
+  diagnostics_pub_.publish(diagnostics);
+}
+
 void PlaneSegmentation::cloudCallback(const sensor_msgs::PointCloud2ConstPtr &msg)
 {
-  is_cloud_updated_ = true;
-  pcl::fromROSMsg(*msg, *raw_cloud_);
+  // never blocks, a frame that was not processed yet is replaced
+  cloud_slot_.publish(msg);
+}
+
+void PlaneSegmentation::cloudDroppedCallback(const sensor_msgs::PointCloud2ConstPtr &msg, tf2_ros::FilterFailureReason reason)
+{
+  ROS_WARN_STREAM_THROTTLE(1.0, "PlaneSegmentation: dropped cloud in " << msg->header.frame_id << " at "
+    << msg->header.stamp << ", no transform to " << base_frame_ << " (reason " << static_cast<int>(reason) << ")");
 }
@@ -0,0 +1,136 @@
+#include <plane_segmentation/plane_tracker.h>
+
+#include <pcl/common/centroid.h>
+#include <pcl/common/eigen.h>
+
+#include <cmath>
+
+PlaneTracker::PlaneTracker(float distance_threshold, float min_inlier_ratio) :
+  distance_threshold_(distance_threshold),
+  min_inlier_ratio_(min_inlier_ratio),
+  state_(NO_PLANE),
+  plane_(Eigen::Vector4f::Zero()),
+  reference_ratio_(0.0f),
+  inlier_ratio_(0.0f),
+  tracked_frames_(0),
+  full_fits_(0)
+{
+}
+
+PlaneTracker::~PlaneTracker()
+{
+}
+
+void PlaneTracker::setDistanceThreshold(float distance)
+{
+  distance_threshold_ = distance;
+}
+
+void PlaneTracker::setMinInlierRatio(float ratio)
+{
+  min_inlier_ratio_ = ratio;
+}
+
+void PlaneTracker::reset()
+{
+  state_ = NO_PLANE;
+  plane_.setZero();
+  reference_ratio_ = 0.0f;
+  inlier_ratio_ = 0.0f;
+}
+
+void PlaneTracker::setPlane(const pcl::ModelCoefficients& coefficients, size_t num_inliers, size_t num_points)
+{
+  if(coefficients.values.size() != 4 || num_points == 0)
+  {
+    reset();
+    return;
+  }
+
+  // keep the normal at unit length, distances are compared against the threshold
+  Eigen::Vector4f plane(coefficients.values[0], coefficients.values[1], coefficients.values[2], coefficients.values[3]);
+  float norm = plane.head<3>().norm();
+  if(norm <= 0.0f)
+  {
+    reset();
+    return;
+  }
+
+  plane_ = plane / norm;
+  reference_ratio_ = static_cast<float>(num_inliers) / num_points;
+  inlier_ratio_ = reference_ratio_;
+  state_ = REFIT;
+  ++full_fits_;
+}
+
+bool PlaneTracker::track(const PointCloud& input, pcl::PointIndices& inliers, pcl::ModelCoefficients& coefficients)
+{
+  inliers.indices.clear();
+  if(state_ == NO_PLANE || input.empty())
+    return false;
+
+  // cheap check: how many points still lie on the previous plane
+  selectInliers(input, plane_, inliers);
+  inlier_ratio_ = static_cast<float>(inliers.indices.size()) / input.size();
+  if(inliers.indices.size() < 3 || inlier_ratio_ < min_inlier_ratio_ * reference_ratio_)
+    return false;
+
+  // least squares refinement over the inliers, smallest eigenvector of the covariance
+  Eigen::Matrix3f covariance;
+  Eigen::Vector4f centroid;
+  if(pcl::computeMeanAndCovarianceMatrix(input, inliers.indices, covariance, centroid) == 0)
+    return false;
+
+  EIGEN_ALIGN16 float eigen_value;
+  Eigen::Vector3f normal;
+  pcl::eigen33(covariance, eigen_value, normal);
+  if(!std::isfinite(normal.norm()))
+    return false;
+
+  // keep the orientation of the tracked plane
+  if(normal.dot(plane_.head<3>()) < 0.0f)
+    normal = -normal;
+  plane_ << normal, -normal.dot(centroid.head<3>());
+
+  // inliers of the refined plane
+  selectInliers(input, plane_, inliers);
+  inliers.header = input.header;
+
+  coefficients.header = input.header;
+  coefficients.values = {plane_[0], plane_[1], plane_[2], plane_[3]};
+
+  state_ = TRACKING;
+  ++tracked_frames_;
+  return !inliers.indices.empty();
+}
+
+const char* PlaneTracker::stateName() const
+{
+  switch(state_)
+  {
+    case TRACKING:
+      return "tracking";
+    case REFIT:
+      return "refit";
+    default:
+      return "no plane";
+  }
+}
+
+double PlaneTracker::hitRate() const
+{
+  uint64_t frames = tracked_frames_ + full_fits_;
+  return frames > 0 ? static_cast<double>(tracked_frames_) / frames : 0.0;
+}
+
+void PlaneTracker::selectInliers(const PointCloud& input, const Eigen::Vector4f& plane, pcl::PointIndices& inliers) const
+{
+  inliers.indices.clear();
+  inliers.indices.reserve(input.size());
+  for(size_t i = 0; i < input.points.size(); ++i)
+  {
+    const PointT& pt = input.points[i];
+    if(std::abs(plane[0] * pt.x + plane[1] * pt.y + plane[2] * pt.z + plane[3]) <= distance_threshold_)
+      inliers.indices.push_back(static_cast<int>(i));
+  }
+}
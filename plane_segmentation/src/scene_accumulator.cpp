@@ -0,0 +1,197 @@
+#include <plane_segmentation/scene_accumulator.h>
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const uint64_t kEmptyKey = std::numeric_limits<uint64_t>::max();   // never a valid 63 bit key
+const uint32_t kMaxWeight = 64;     // the means follow the latest points, e.g. a shifted object
+
+}  // namespace
+
+const int SceneAccumulator::kMaxFrames;
+
+SceneAccumulator::SceneAccumulator(float leaf_size, int frames, int min_hits, size_t max_voxels) :
+  frames_(1),
+  min_hits_(1),
+  window_mask_(1),
+  max_voxels_(max_voxels),
+  table_mask_(0),
+  frame_count_(0),
+  dropped_points_(0)
+{
+  setLeafSize(leaf_size);
+  setFrames(frames);
+  setMinHits(min_hits);
+}
+
+SceneAccumulator::~SceneAccumulator()
+{
+}
+
+void SceneAccumulator::setLeafSize(float leaf_size)
+{
+  leaf_size_ = leaf_size;
+  inv_leaf_size_ = 1.0f / leaf_size;
+  reset();
+}
+
+void SceneAccumulator::setFrames(int frames)
+{
+  frames_ = std::max(1, std::min(frames, kMaxFrames));
+  window_mask_ = frames_ == 64 ? std::numeric_limits<uint64_t>::max() : (uint64_t(1) << frames_) - 1;
+  min_hits_ = std::min(min_hits_, frames_);
+}
+
+void SceneAccumulator::setMinHits(int min_hits)
+{
+  min_hits_ = std::max(1, std::min(min_hits, frames_));
+}
+
+void SceneAccumulator::setMaxVoxels(size_t max_voxels)
+{
+  max_voxels_ = max_voxels;
+  keys_.clear();
+  slots_.clear();
+  reset();
+}
+
+void SceneAccumulator::reset()
+{
+  std::fill(keys_.begin(), keys_.end(), kEmptyKey);
+  voxels_.clear();
+  frame_count_ = 0;
+  dropped_points_ = 0;
+}
+
+void SceneAccumulator::allocateTable()
+{
+  // power of two with a load factor of at most 1/2 for a full map
+  size_t size = 16;
+  while(size < 2 * max_voxels_)
+    size *= 2;
+  keys_.assign(size, kEmptyKey);
+  slots_.assign(size, 0);
+  table_mask_ = size - 1;
+}
+
+uint64_t SceneAccumulator::voxelKey(int i, int j, int k)
+{
+  // 21 bits per axis, enough for +-10km at 1cm leaf size
+  return (static_cast<uint64_t>(i & 0x1FFFFF) << 42) |
+         (static_cast<uint64_t>(j & 0x1FFFFF) << 21) |
+          static_cast<uint64_t>(k & 0x1FFFFF);
+}
+
+void SceneAccumulator::age()
+{
+  // one frame older, voxels without hits inside the window expire
+  size_t kept = 0;
+  for(size_t idx = 0; idx < voxels_.size(); ++idx)
+  {
+    Voxel& voxel = voxels_[idx];
+    voxel.hits = (voxel.hits << 1) & window_mask_;
+    if(voxel.hits != 0)
+      voxels_[kept++] = voxel;
+  }
+  voxels_.resize(kept);
+
+  // rebuild the table, cheaper than tombstones for a map that changes every frame
+  std::fill(keys_.begin(), keys_.end(), kEmptyKey);
+  for(size_t idx = 0; idx < voxels_.size(); ++idx)
+  {
+    uint64_t key = voxelKey(voxels_[idx].i, voxels_[idx].j, voxels_[idx].k);
+    size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & table_mask_;
+    while(keys_[slot] != kEmptyKey)
+      slot = (slot + 1) & table_mask_;
+    keys_[slot] = key;
+    slots_[slot] = static_cast<uint32_t>(idx);
+  }
+}
+
+int64_t SceneAccumulator::findOrInsert(int i, int j, int k)
+{
+  // fibonacci hashing, linear probing
+  uint64_t key = voxelKey(i, j, k);
+  size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & table_mask_;
+  while(keys_[slot] != kEmptyKey)
+  {
+    if(keys_[slot] == key)
+      return slots_[slot];
+    slot = (slot + 1) & table_mask_;
+  }
+
+  if(voxels_.size() >= max_voxels_)
+    return -1;
+
+  keys_[slot] = key;
+  slots_[slot] = static_cast<uint32_t>(voxels_.size());
+  voxels_.push_back(Voxel{i, j, k, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0});
+  return slots_[slot];
+}
+
+void SceneAccumulator::add(const PointCloud& input)
+{
+  // the table is only allocated once the accumulator is used
+  if(keys_.empty())
+    allocateTable();
+  age();
+  ++frame_count_;
+  dropped_points_ = 0;
+  header_ = input.header;
+
+  for(const PointT& pt : input.points)
+  {
+    if(!std::isfinite(pt.x) || !std::isfinite(pt.y) || !std::isfinite(pt.z))
+      continue;
+
+    int i = static_cast<int>(std::floor(pt.x * inv_leaf_size_));
+    int j = static_cast<int>(std::floor(pt.y * inv_leaf_size_));
+    int k = static_cast<int>(std::floor(pt.z * inv_leaf_size_));
+    int64_t idx = findOrInsert(i, j, k);
+    if(idx < 0)
+    {
+      ++dropped_points_;
+      continue;
+    }
+
+    // running means, bounded weight so old observations fade out
+    Voxel& voxel = voxels_[idx];
+    voxel.hits |= 1;
+    if(voxel.count < kMaxWeight)
+      ++voxel.count;
+    float w = 1.0f / voxel.count;
+    voxel.x += w * (pt.x - voxel.x);
+    voxel.y += w * (pt.y - voxel.y);
+    voxel.z += w * (pt.z - voxel.z);
+    voxel.r += w * (pt.r - voxel.r);
+    voxel.g += w * (pt.g - voxel.g);
+    voxel.b += w * (pt.b - voxel.b);
+  }
+}
+
+void SceneAccumulator::extract(PointCloud& output) const
+{
+  output.points.clear();
+  output.header = header_;
+
+  PointT pt;
+  for(const Voxel& voxel : voxels_)
+  {
+    if(static_cast<int>(std::bitset<64>(voxel.hits).count()) < min_hits_)
+      continue;
+    pt.x = voxel.x;
+    pt.y = voxel.y;
+    pt.z = voxel.z;
+    pt.r = static_cast<uint8_t>(voxel.r + 0.5f);
+    pt.g = static_cast<uint8_t>(voxel.g + 0.5f);
+    pt.b = static_cast<uint8_t>(voxel.b + 0.5f);
+    output.points.push_back(pt);
+  }
+  output.width = static_cast<uint32_t>(output.points.size());
+  output.height = 1;
+  output.is_dense = true;
+}
@@ -0,0 +1,290 @@
+#include <gtest/gtest.h>
+
+#include <plane_segmentation/cloud_preprocessor.h>
+
+#include <pcl_conversions/pcl_conversions.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/common/transforms.h>
+#include <pcl/filters/crop_box.h>
+#include <pcl/filters/passthrough.h>
+#include <pcl/filters/voxel_grid.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <random>
+
+typedef CloudPreprocessor::PointT PointT;
+typedef CloudPreprocessor::PointCloud PointCloud;
+
+namespace {
+
+const float kLeafSize = 0.01f;
+const float kPassLow = -0.1f;
+const float kPassHigh = 0.2f;
+
+/**
+ * @brief organized table scene as seen from the head camera: floor, a table
+ * top with a few boxes on it and a wall, with invalid (NaN) pixels in between
+ */
+PointCloud::Ptr createScene(unsigned int seed)
+{
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> noise(-0.003f, 0.003f);
+  std::uniform_int_distribution<int> color(0, 255);
+  std::bernoulli_distribution invalid(0.05);
+
+  PointCloud::Ptr cloud(new PointCloud);
+  cloud->width = 160;
+  cloud->height = 120;
+  cloud->is_dense = false;
+  cloud->points.resize(cloud->width * cloud->height);
+  cloud->header.frame_id = "head_rgbd_sensor_rgb_frame";
+
+  for(uint32_t v = 0; v < cloud->height; ++v)
+  {
+    for(uint32_t u = 0; u < cloud->width; ++u)
+    {
+      PointT& pt = cloud->points[v * cloud->width + u];
+      pt.r = color(gen);
+      pt.g = color(gen);
+      pt.b = color(gen);
+      if(invalid(gen))
+      {
+        pt.x = pt.y = pt.z = std::numeric_limits<float>::quiet_NaN();
+        continue;
+      }
+
+      // camera looking along +z, image rows map to the depth layers of the scene
+      float x = (u - 80.0f) * 0.01f;
+      float y = (v - 60.0f) * 0.01f;
+      float depth = 2.0f;                       // wall
+      if(v > 40) depth = 1.0f + 0.01f * v;      // floor
+      if(v > 50 && v < 90 && std::abs(x) < 0.5f)
+        depth = 0.8f + 0.005f * (v - 50);       // table top
+      if(v > 55 && v < 70 && std::abs(x - 0.2f) < 0.05f)
+        depth = 0.75f;                          // object on table
+
+      pt.x = x * depth + noise(gen);
+      pt.y = y * depth + noise(gen);
+      pt.z = depth + noise(gen);
+    }
+  }
+  return cloud;
+}
+
+/**
+ * @brief camera pose in base frame, looking down onto the table
+ */
+Eigen::Affine3f createTransform(float tilt, float height)
+{
+  Eigen::Affine3f T_base_sensor = Eigen::Affine3f::Identity();
+  T_base_sensor.translate(Eigen::Vector3f(0.1f, 0.0f, height));
+  T_base_sensor.rotate(Eigen::AngleAxisf(-M_PI_2 - tilt, Eigen::Vector3f::UnitX()));
+  return T_base_sensor;
+}
+
+/**
+ * @brief the original preprocessing chain of PlaneSegmentation
+ */
+void referenceChain(const PointCloud::Ptr& input, const Eigen::Affine3f& T_base_sensor, PointCloud& output)
+{
+  PointCloud::Ptr ds_cloud(new PointCloud);
+  pcl::VoxelGrid<PointT> sor;
+  sor.setInputCloud(input);
+  sor.setLeafSize(kLeafSize, kLeafSize, kLeafSize);
+  sor.filter(*ds_cloud);
+
+  PointCloud::Ptr transf_cloud(new PointCloud);
+  pcl::transformPointCloud(*ds_cloud, *transf_cloud, T_base_sensor);
+
+  pcl::PassThrough<PointT> pass;
+  pass.setInputCloud(transf_cloud);
+  pass.setFilterFieldName("z");
+  pass.setFilterLimits(kPassLow, kPassHigh);
+  pass.filter(output);
+}
+
+void expectEqualClouds(const PointCloud& expected, const PointCloud& actual)
+{
+  ASSERT_EQ(expected.size(), actual.size());
+  for(size_t i = 0; i < expected.size(); ++i)
+  {
+    EXPECT_NEAR(expected.points[i].x, actual.points[i].x, 1e-5);
+    EXPECT_NEAR(expected.points[i].y, actual.points[i].y, 1e-5);
+    EXPECT_NEAR(expected.points[i].z, actual.points[i].z, 1e-5);
+    EXPECT_EQ(expected.points[i].r, actual.points[i].r);
+    EXPECT_EQ(expected.points[i].g, actual.points[i].g);
+    EXPECT_EQ(expected.points[i].b, actual.points[i].b);
+  }
+}
+
+}  // namespace
+
+TEST(CloudPreprocessor, matchesPclChainOnCloud)
+{
+  CloudPreprocessor preprocessor(kLeafSize);
+  preprocessor.setFilterLimits(kPassLow, kPassHigh);
+
+  for(unsigned int seed = 0; seed < 5; ++seed)
+  {
+    PointCloud::Ptr scene = createScene(seed);
+    Eigen::Affine3f T_base_sensor = createTransform(0.3f + 0.1f * seed, 0.9f + 0.05f * seed);
+
+    PointCloud expected;
+    referenceChain(scene, T_base_sensor, expected);
+    ASSERT_GT(expected.size(), 0u);
+
+    PointCloud actual;
+    preprocessor.setTransform(T_base_sensor);
+    ASSERT_TRUE(preprocessor.process(*scene, actual));
+    expectEqualClouds(expected, actual);
+  }
+}
+
+TEST(CloudPreprocessor, matchesPclChainOnMessage)
+{
+  CloudPreprocessor preprocessor(kLeafSize);
+  preprocessor.setFilterLimits(kPassLow, kPassHigh);
+
+  for(unsigned int seed = 0; seed < 5; ++seed)
+  {
+    PointCloud::Ptr scene = createScene(seed);
+    Eigen::Affine3f T_base_sensor = createTransform(0.5f, 1.0f);
+
+    PointCloud expected;
+    referenceChain(scene, T_base_sensor, expected);
+
+    sensor_msgs::PointCloud2 msg;
+    pcl::toROSMsg(*scene, msg);
+
+    PointCloud actual;
+    preprocessor.setTransform(T_base_sensor);
+    ASSERT_TRUE(preprocessor.process(msg, actual));
+    expectEqualClouds(expected, actual);
+    EXPECT_EQ(actual.header.frame_id, scene->header.frame_id);
+  }
+}
+
+TEST(CloudPreprocessor, matchesPclChainWithWorkspace)
+{
+  // narrower than the scene in x, tighter than the pass filter at the top
+  Eigen::Vector3f workspace_min(-0.3f, -10.0f, -10.0f);
+  Eigen::Vector3f workspace_max(0.4f, 10.0f, 0.15f);
+
+  CloudPreprocessor preprocessor(kLeafSize);
+  preprocessor.setFilterLimits(kPassLow, kPassHigh);
+  preprocessor.setWorkspace(workspace_min, workspace_max);
+
+  for(unsigned int seed = 0; seed < 5; ++seed)
+  {
+    PointCloud::Ptr scene = createScene(seed);
+    Eigen::Affine3f T_base_sensor = createTransform(0.3f + 0.1f * seed, 0.9f + 0.05f * seed);
+
+    PointCloud::Ptr uncropped(new PointCloud);
+    referenceChain(scene, T_base_sensor, *uncropped);
+
+    PointCloud expected;
+    pcl::CropBox<PointT> crop;
+    crop.setInputCloud(uncropped);
+    crop.setMin(Eigen::Vector4f(workspace_min.x(), workspace_min.y(), workspace_min.z(), 1.0f));
+    crop.setMax(Eigen::Vector4f(workspace_max.x(), workspace_max.y(), workspace_max.z(), 1.0f));
+    crop.filter(expected);
+    ASSERT_GT(expected.size(), 0u);
+    ASSERT_LT(expected.size(), uncropped->size());
+
+    sensor_msgs::PointCloud2 msg;
+    pcl::toROSMsg(*scene, msg);
+
+    PointCloud actual;
+    preprocessor.setTransform(T_base_sensor);
+    ASSERT_TRUE(preprocessor.process(msg, actual));
+    expectEqualClouds(expected, actual);
+    EXPECT_LT(preprocessor.acceptedPoints(), preprocessor.inputPoints());
+  }
+}
+
+TEST(CloudPreprocessor, matchesPclChainOnRecordedClouds)
+{
+  // recorded head camera clouds (*.pcd, sensor frame), e.g. exported with pcl_ros bag_to_pcd
+  const char* data_dir = std::getenv("PLANE_SEGMENTATION_TEST_DATA");
+  if(data_dir == nullptr || !boost::filesystem::is_directory(data_dir))
+  {
+    std::cout << "PLANE_SEGMENTATION_TEST_DATA not set, skipping recorded clouds" << std::endl;
+    return;
+  }
+
+  CloudPreprocessor preprocessor(kLeafSize);
+  preprocessor.setFilterLimits(kPassLow, kPassHigh);
+  Eigen::Affine3f T_base_sensor = createTransform(0.6f, 1.0f);
+  preprocessor.setTransform(T_base_sensor);
+
+  boost::filesystem::directory_iterator it(data_dir), end;
+  for(; it != end; ++it)
+  {
+    if(it->path().extension() != ".pcd")
+      continue;
+
+    PointCloud::Ptr cloud(new PointCloud);
+    ASSERT_EQ(pcl::io::loadPCDFile(it->path().string(), *cloud), 0);
+
+    PointCloud expected;
+    referenceChain(cloud, T_base_sensor, expected);
+
+    sensor_msgs::PointCloud2 msg;
+    pcl::toROSMsg(*cloud, msg);
+
+    PointCloud actual;
+    ASSERT_TRUE(preprocessor.process(msg, actual));
+    expectEqualClouds(expected, actual);
+  }
+}
+
+TEST(CloudPreprocessor, rejectsMessageWithoutCoordinates)
+{
+  sensor_msgs::PointCloud2 msg;
+  msg.height = 1;
+  msg.width = 1;
+
+  CloudPreprocessor preprocessor(kLeafSize);
+  PointCloud output;
+  EXPECT_FALSE(preprocessor.process(msg, output));
+}
+
+TEST(CloudPreprocessor, rejectsMalformedMessage)
+{
+  PointCloud::Ptr scene = createScene(0);
+  sensor_msgs::PointCloud2 valid;
+  pcl::toROSMsg(*scene, valid);
+
+  CloudPreprocessor preprocessor(kLeafSize);
+  PointCloud output;
+  ASSERT_TRUE(preprocessor.process(valid, output));
+
+  // truncated buffer, the last rows are missing
+  sensor_msgs::PointCloud2 msg = valid;
+  msg.data.resize(msg.data.size() - msg.row_step / 2);
+  EXPECT_FALSE(preprocessor.process(msg, output));
+
+  // rows shorter than their points
+  msg = valid;
+  msg.row_step -= msg.point_step;
+  EXPECT_FALSE(preprocessor.process(msg, output));
+
+  // field beyond the end of a point
+  msg = valid;
+  for(sensor_msgs::PointField& field : msg.fields)
+  {
+    if(field.name == "z")
+      field.offset = msg.point_step - 2;
+  }
+  EXPECT_FALSE(preprocessor.process(msg, output));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <plane_segmentation/plane_segmentation.h>
+
+#include <cmath>
+
+typedef PlaneSegmentation::PointT PointT;
+typedef PlaneSegmentation::PointCloud PointCloud;
+
+namespace {
+
+const double kMaxPlaneAngle = 10.0;
+
+/**
+ * @brief 60cm x 60cm table top in base frame, tilted about the y axis
+ * through its center by angle degrees
+ */
+sensor_msgs::PointCloud2ConstPtr createTable(double angle)
+{
+  PointCloud cloud;
+  float slope = std::tan(angle * M_PI / 180.0);
+  for(int i = 0; i < 60; ++i)
+  {
+    for(int j = 0; j < 60; ++j)
+    {
+      PointT pt;
+      pt.x = 0.305f + 0.01f * i;
+      pt.y = -0.295f + 0.01f * j;
+      pt.z = 0.05f + slope * (pt.x - 0.6f);
+      pt.r = pt.g = pt.b = 128;
+      cloud.push_back(pt);
+    }
+  }
+  cloud.header.frame_id = "base_footprint";
+
+  sensor_msgs::PointCloud2Ptr msg(new sensor_msgs::PointCloud2);
+  pcl::toROSMsg(cloud, *msg);
+  return msg;
+}
+
+}  // namespace
+
+TEST(PlaneSegmentation, dropsTrackedPlaneTiltedPastMaxAngle)
+{
+  PlaneSegmentation segmentation("", "base_footprint");
+  PlaneSegmentation::Parameters params;
+  params.horizontal_planes = true;
+  params.max_plane_angle = kMaxPlaneAngle;
+  params.plane_tracking = true;
+  ASSERT_TRUE(segmentation.configure(params));
+
+  // the table tilts by one degree per frame, little enough to stay tracked
+  const float min_normal_z = std::cos(kMaxPlaneAngle * M_PI / 180.0);
+  for(int angle = 0; angle <= 20; ++angle)
+  {
+    bool segmented = segmentation.process(createTable(angle), Eigen::Affine3f::Identity());
+    if(angle < kMaxPlaneAngle)
+    {
+      EXPECT_TRUE(segmented) << angle << " deg";
+    }
+    else if(angle > kMaxPlaneAngle + 1)
+    {
+      EXPECT_FALSE(segmented) << angle << " deg";
+    }
+
+    if(segmented)
+    {
+      ASSERT_FALSE(segmentation.planes().planes.empty());
+      EXPECT_GE(std::abs(segmentation.planes().planes[0].coefficients[2]), min_normal_z) << angle << " deg";
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  // ros time is used by the throttled log messages, without a master it is the wall time
+  ros::Time::init();
+  return RUN_ALL_TESTS();
+}
@@ -61,11 +61,17 @@ class ObjectInfo(object):
         return self._marker.text
     
     def get_class_id(self) -> int:
-        """Gets the class id of the object as seen in the
-        point cloud.
+        """Gets the class id of the object.
         """
         return self._class_to_id[self.get_class()]
 
+    def get_object_id(self) -> int:
+        """Gets the object id of the object as seen in the
+        labeled point cloud. It stays the same while the
+        object is tracked.
+        """
+        return self._marker.id
+
     def get_dropoff_location(self) -> PoseStamped:
         """Gets the location of the dropoff point
         for this object in the map frame. Dropoff point 
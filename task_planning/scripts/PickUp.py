@@ -2,13 +2,18 @@
 
 import rospy
 import math
+import numpy as np
 import smach
 
 import hsrb_interface
+import tf
 
+from ObjectInfo import ObjectInfo
 from object_manipulation.srv import *
+from object_labeling.msg import LabeledObjects
 from sensor_msgs.msg import PointCloud2
 from geometry_msgs.msg import PointStamped
+from std_msgs.msg import Header
 from message_filters import Subscriber, ApproximateTimeSynchronizer
 
 """This state tries to pickup the target object using moveit.
@@ -23,19 +28,20 @@ class PickUp(smach.State):
         rospy.wait_for_service("pickup")
 
         # subscribers for the robot point clouds
-        self._labeled_object_cloud_sub = Subscriber("/labeled_object_point_cloud", PointCloud2)
+        self._labeled_objects_sub = Subscriber("/labeled_objects", LabeledObjects)
         self._camera_point_cloud_sub = Subscriber("/combined_point_cloud", PointCloud2)
 
         # synchronise the subscribers
-        self._sync_sub = ApproximateTimeSynchronizer([self._labeled_object_cloud_sub, 
+        self._sync_sub = ApproximateTimeSynchronizer([self._labeled_objects_sub, 
                                                       self._camera_point_cloud_sub], 
                                                       queue_size=1, 
                                                       slop=0.1)
         self._sync_sub.registerCallback(self._point_cloud_callback)
 
-        self._labeled_cloud_msg = None
+        self._labeled_objects_msg = None
         self._camera_cloud_msg = None
         self._sync_called = False
+        self._tf_listener = tf.TransformListener()
 
     def _rotate_head(self, robot, pan_deg=0, tilt_deg=0):
         """Rotate the robot head about pan and tilt joints
@@ -49,7 +55,7 @@ class PickUp(smach.State):
 
     def _pickup(self, 
                 env_cloud:PointCloud2, 
-                obj_cloud:PointCloud2, 
+                objects:LabeledObjects, 
                 obj_class:str, 
                 obj_id:int,
                 centroid:PointStamped) -> PickupResponse:
@@ -59,7 +65,7 @@ class PickUp(smach.State):
         try:
             pickup = rospy.ServiceProxy("pickup", Pickup)
             return pickup.call(environment_cloud=env_cloud,
-                               object_cloud=obj_cloud,
+                               objects=objects,
                                object_class=obj_class,
                                object_id=obj_id,
                                object_centroid=centroid)
@@ -68,8 +74,53 @@ class PickUp(smach.State):
 
         return None
 
-    def _point_cloud_callback(self, labeled_cloud_msg, camera_cloud_msg):
-        self._labeled_cloud_msg = labeled_cloud_msg
+    def _resolve_object_id(self, target_object:ObjectInfo, objects:LabeledObjects) -> int:
+        """Gets the id of the target object in the labeled objects.
+        Ids are stable while an object is tracked, but the object
+        may have been out of view since it was located. The object
+        of the same class with the closest centroid is taken then.
+        """
+        object_id = target_object.get_object_id()
+        if object_id in objects.object_ids:
+            return object_id
+
+        # target centroid in the frame of the labeled objects
+        try:
+            # a new header, the one of the position is shared with the stored marker
+            position = target_object.get_position()
+            target = PointStamped(header=Header(frame_id=position.header.frame_id,
+                                                stamp=rospy.Time(0)),
+                                  point=position.point)
+            target = self._tf_listener.transformPoint(objects.header.frame_id, target).point
+        except tf.Exception as e:
+            rospy.logwarn(f"Could not transform the target object: {e}")
+            return object_id
+
+        # the points of object i are one slice of the cloud
+        cloud = objects.cloud
+        columns = {field.name: field.offset // 4 for field in cloud.fields}
+        points = np.frombuffer(cloud.data, dtype=np.float32).reshape(-1, cloud.point_step // 4)
+        xyz = points[:, [columns["x"], columns["y"], columns["z"]]]
+
+        best_dist = math.inf
+        for i, (candidate_id, candidate_class) in enumerate(zip(objects.object_ids,
+                                                                 objects.object_classes)):
+            begin = objects.object_offsets[i]
+            end = objects.object_offsets[i + 1]
+            if candidate_class != target_object.get_class() or begin == end:
+                continue
+            centroid = xyz[begin:end].mean(axis=0)
+            dist = math.sqrt((centroid[0] - target.x)**2 +
+                             (centroid[1] - target.y)**2 +
+                             (centroid[2] - target.z)**2)
+            if dist < best_dist:
+                best_dist = dist
+                object_id = candidate_id
+
+        return object_id
+
+    def _point_cloud_callback(self, labeled_objects_msg, camera_cloud_msg):
+        self._labeled_objects_msg = labeled_objects_msg
         self._camera_cloud_msg = camera_cloud_msg
         self._sync_called = True
 
@@ -109,9 +160,10 @@ class PickUp(smach.State):
 
             target_object = ud.pickup_info[ud.current_pickup_index]
             response = self._pickup(self._camera_cloud_msg,
-                                    self._labeled_cloud_msg,
+                                    self._labeled_objects_msg,
                                     target_object.get_class(),
-                                    target_object.get_class_id(),
+                                    self._resolve_object_id(target_object,
+                                                            self._labeled_objects_msg),
                                     target_object.get_position())
             if response is not None:
                 if response.succeeded: